@@ -0,0 +1,196 @@
+// Benchmark of the CSI preprocessing kernels in csi_features.c. Compares the
+// vectorized kernels against the scalar reference on recorded or synthetic
+// frames and checks that both produce identical results.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "csi_features.h"
+#include "csi_synth.h"
+
+#define DEFAULT_SUBCARRIERS 64
+#define DEFAULT_FRAMES      64
+#define DEFAULT_ROUNDS      2000
+
+struct Params {
+    const char *file;
+    size_t subcarriers;
+    size_t frames;
+    size_t rounds;
+} params = {
+    .subcarriers = DEFAULT_SUBCARRIERS,
+    .frames = DEFAULT_FRAMES,
+    .rounds = DEFAULT_ROUNDS,
+};
+
+/** Parse params and save them to 'params' global struct */
+int parse_params(int argc, char **argv);
+/** Fill 'frames' ring slots from params.file or with synthetic CSI */
+int load_frames(uint8_t *frames);
+/** Run 'kernel' over all frames params.rounds times, return ns per frame */
+double bench_kernel(const uint8_t *frames, void *out,
+                    void (*kernel)(const int16_t *, void *, size_t));
+
+// adapters to the common kernel signature used by bench_kernel()
+static void amp_scalar(const int16_t *iq, void *out, size_t n) {
+    csi_amplitude_scalar(iq, out, n);
+}
+static void amp_fast(const int16_t *iq, void *out, size_t n) {
+    csi_amplitude(iq, out, n);
+}
+static void phase_scalar(const int16_t *iq, void *out, size_t n) {
+    csi_phase_scalar(iq, out, n);
+}
+static void phase_fast(const int16_t *iq, void *out, size_t n) {
+    csi_phase(iq, out, n);
+}
+
+int main(int argc, char **argv) {
+    if (parse_params(argc, argv)) {
+        return -1;
+    }
+
+    uint8_t *frames = calloc(params.frames, CSI_RING_SLOT_SIZE);
+    uint16_t *amp = malloc(params.frames * params.subcarriers * sizeof(*amp));
+    uint16_t *amp_ref = malloc(params.frames * params.subcarriers * sizeof(*amp));
+    int16_t *phase = malloc(params.frames * params.subcarriers * sizeof(*phase));
+    int16_t *phase_ref = malloc(params.frames * params.subcarriers * sizeof(*phase));
+    if (frames == NULL || amp == NULL || amp_ref == NULL || phase == NULL ||
+        phase_ref == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    if (load_frames(frames)) {
+        return -1;
+    }
+
+    printf("%zu frames x %zu subcarriers, %zu rounds, %s kernels\n",
+           params.frames, params.subcarriers, params.rounds,
+#ifdef CSI_FEATURES_NEON
+           "NEON"
+#else
+           "scalar"
+#endif
+           );
+
+    double amp_scalar_ns = bench_kernel(frames, amp_ref, amp_scalar);
+    double amp_fast_ns = bench_kernel(frames, amp, amp_fast);
+    double phase_scalar_ns = bench_kernel(frames, phase_ref, phase_scalar);
+    double phase_fast_ns = bench_kernel(frames, phase, phase_fast);
+    size_t values = params.frames * params.subcarriers;
+    int amp_exact = memcmp(amp, amp_ref, values * sizeof(*amp)) == 0;
+    int phase_exact = memcmp(phase, phase_ref, values * sizeof(*phase)) == 0;
+
+    printf("%-10s %12s %12s %8s %s\n", "kernel", "scalar", "dispatched", "speedup", "bit-exact");
+    printf("%-10s %9.1f ns %9.1f ns %7.2fx %s\n", "amplitude", amp_scalar_ns, amp_fast_ns,
+           amp_scalar_ns / amp_fast_ns, amp_exact ? "yes" : "NO");
+    printf("%-10s %9.1f ns %9.1f ns %7.2fx %s\n", "phase", phase_scalar_ns, phase_fast_ns,
+           phase_scalar_ns / phase_fast_ns, phase_exact ? "yes" : "NO");
+
+    // whole fingerprint: every frame through all kernels plus the statistics
+    static struct csi_feature_acc acc;
+    struct csi_features features;
+    uint64_t time = csi_now_ns();
+    for (size_t r = 0; r < params.rounds; ++r) {
+        csi_features_init(&acc, params.subcarriers);
+        for (size_t f = 0; f < params.frames; ++f) {
+            csi_features_add(&acc, (void *)(frames + f * CSI_RING_SLOT_SIZE));
+        }
+        csi_features_finish(&acc, &features);
+    }
+    time = csi_now_ns() - time;
+    printf("fingerprint: %.3f ms for %zu frames -> %zu bytes\n",
+           (double)time / params.rounds / 1e6, params.frames, sizeof(features));
+
+    free(phase_ref);
+    free(phase);
+    free(amp_ref);
+    free(amp);
+    free(frames);
+    return amp_exact && phase_exact ? 0 : 1;
+}
+
+int parse_params(int argc, char **argv) {
+    char usage_str[] = "%s [-f raw_iq_file] [-s subcarriers] [-n frames] [-r rounds]\n"
+                       "  raw_iq_file holds consecutive frames of little-endian int16 I/Q pairs\n";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:s:n:r:")) != -1) {
+        switch (opt) {
+            case 'f':
+                params.file = optarg;
+                break;
+            case 's':
+                params.subcarriers = strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                params.frames = strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                params.rounds = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, usage_str, argv[0]);
+                return -1;
+        }
+    }
+    if (params.subcarriers == 0 || params.subcarriers > CSI_MAX_SUBCARRIERS ||
+        params.subcarriers % CSI_FEATURE_BINS || params.frames == 0 ||
+        params.rounds == 0) {
+        fprintf(stderr, usage_str, argv[0]);
+        return -1;
+    }
+    return 0;
+}
+
+int load_frames(uint8_t *frames) {
+    size_t frame_bytes = params.subcarriers * 2 * sizeof(int16_t);
+    FILE *f = NULL;
+
+    if (params.file && (f = fopen(params.file, "rb")) == NULL) {
+        perror(params.file);
+        return -1;
+    }
+    for (size_t i = 0; i < params.frames; ++i) {
+        struct csi_frame_hdr *frame = (void *)(frames + i * CSI_RING_SLOT_SIZE);
+        int16_t *iq = csi_frame_payload(frame);
+
+        frame->subcarriers = params.subcarriers;
+        frame->len = frame_bytes;
+        if (f) {
+            if (fread(iq, frame_bytes, 1, f) != 1) {
+                // shorter recordings are repeated
+                rewind(f);
+                if (fread(iq, frame_bytes, 1, f) != 1) {
+                    fprintf(stderr, "%s: shorter than one frame\n", params.file);
+                    fclose(f);
+                    return -1;
+                }
+            }
+            continue;
+        }
+        csi_synth_frame(iq, params.subcarriers, i);
+    }
+    if (f) {
+        fclose(f);
+    }
+    return 0;
+}
+
+double bench_kernel(const uint8_t *frames, void *out,
+                    void (*kernel)(const int16_t *, void *, size_t)) {
+    // uint16_t and int16_t outputs have the same size
+    uint16_t *dst = out;
+    uint64_t time = csi_now_ns();
+
+    for (size_t r = 0; r < params.rounds; ++r) {
+        for (size_t f = 0; f < params.frames; ++f) {
+            const struct csi_frame_hdr *frame = (void *)(frames + f * CSI_RING_SLOT_SIZE);
+            kernel((const int16_t *)(frame + 1), dst + f * params.subcarriers,
+                   params.subcarriers);
+        }
+    }
+    time = csi_now_ns() - time;
+    return (double)time / params.rounds / params.frames;
+}
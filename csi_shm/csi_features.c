@@ -0,0 +1,261 @@
+#include <string.h>
+
+#include "csi_features.h"
+
+#ifdef CSI_FEATURES_NEON
+#include <arm_neon.h>
+#endif
+
+#define BAM_QUARTER 16384
+#define BAM_HALF    32768
+
+// atan(r) ~ pi/4 r + 0.273 r (1 - r) for r in [0, 1], in binary angles
+#define ATAN_LINEAR 8192
+#define ATAN_QUAD   2847
+
+static uint32_t isqrt64(uint64_t v) {
+    uint64_t res = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= res + bit) {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
+
+static int16_t clamp16(int64_t v) {
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+}
+
+void csi_amplitude_scalar(const int16_t *iq, uint16_t *amp, size_t n) {
+    for (size_t k = 0; k < n; ++k) {
+        uint32_t x = iq[2 * k] < 0 ? -(int32_t)iq[2 * k] : iq[2 * k];
+        uint32_t y = iq[2 * k + 1] < 0 ? -(int32_t)iq[2 * k + 1] : iq[2 * k + 1];
+        uint32_t hi = x > y ? x : y;
+        uint32_t lo = x > y ? y : x;
+        uint32_t est = hi - (hi >> 3) + (lo >> 1);
+
+        amp[k] = est > hi ? est : hi;
+    }
+}
+
+void csi_phase_scalar(const int16_t *iq, int16_t *phase, size_t n) {
+    for (size_t k = 0; k < n; ++k) {
+        int32_t x = iq[2 * k];
+        int32_t y = iq[2 * k + 1];
+        uint32_t ax = x < 0 ? -x : x;
+        uint32_t ay = y < 0 ? -y : y;
+        uint32_t hi = ax > ay ? ax : ay;
+        uint32_t lo = ax > ay ? ay : ax;
+        // r = lo / hi in Q15
+        uint32_t r = hi ? (lo << 15) / hi : 0;
+        int32_t a = (ATAN_LINEAR * r + ATAN_QUAD * ((r * (BAM_HALF - r)) >> 15)) >> 15;
+
+        a = ay > ax ? BAM_QUARTER - a : a;
+        a = x < 0 ? BAM_HALF - a : a;
+        a = y < 0 ? -a : a;
+        phase[k] = (int16_t)(uint16_t)a;
+    }
+}
+
+#ifdef CSI_FEATURES_NEON
+void csi_amplitude(const int16_t *iq, uint16_t *amp, size_t n) {
+    size_t k = 0;
+
+    for (; k + 8 <= n; k += 8) {
+        int16x8x2_t v = vld2q_s16(iq + 2 * k);
+        // |-32768| stays 0x8000, which is right once read as unsigned
+        uint16x8_t x = vreinterpretq_u16_s16(vabsq_s16(v.val[0]));
+        uint16x8_t y = vreinterpretq_u16_s16(vabsq_s16(v.val[1]));
+        uint16x8_t hi = vmaxq_u16(x, y);
+        uint16x8_t lo = vminq_u16(x, y);
+        uint16x8_t est = vaddq_u16(vsubq_u16(hi, vshrq_n_u16(hi, 3)),
+                                   vshrq_n_u16(lo, 1));
+
+        vst1q_u16(amp + k, vmaxq_u16(est, hi));
+    }
+    csi_amplitude_scalar(iq + 2 * k, amp + k, n - k);
+}
+
+/** floor(num / den) per lane, 0 for 0 / 0 like the scalar code */
+static inline uint32x4_t div_u32(uint32x4_t num, uint32x4_t den) {
+    // operands stay below 2^31, so the correctly rounded double quotient
+    // never crosses an integer and truncating it is exact
+    float64x2_t lo = vdivq_f64(vcvtq_f64_u64(vmovl_u32(vget_low_u32(num))),
+                               vcvtq_f64_u64(vmovl_u32(vget_low_u32(den))));
+    float64x2_t hi = vdivq_f64(vcvtq_f64_u64(vmovl_u32(vget_high_u32(num))),
+                               vcvtq_f64_u64(vmovl_u32(vget_high_u32(den))));
+
+    // NaN of 0 / 0 converts to 0
+    return vcombine_u32(vmovn_u64(vcvtq_u64_f64(lo)),
+                        vmovn_u64(vcvtq_u64_f64(hi)));
+}
+
+/** atan of r = lo / hi in Q15, as binary angle in [0, 8192] */
+static inline uint16x4_t atan_q15(uint16x4_t lo, uint16x4_t hi) {
+    uint32x4_t r = div_u32(vshlq_n_u32(vmovl_u16(lo), 15), vmovl_u16(hi));
+    uint32x4_t quad = vshrq_n_u32(vmulq_u32(r, vsubq_u32(vdupq_n_u32(BAM_HALF), r)), 15);
+    uint32x4_t a = vaddq_u32(vmulq_n_u32(r, ATAN_LINEAR), vmulq_n_u32(quad, ATAN_QUAD));
+
+    return vmovn_u32(vshrq_n_u32(a, 15));
+}
+
+void csi_phase(const int16_t *iq, int16_t *phase, size_t n) {
+    size_t k = 0;
+
+    for (; k + 8 <= n; k += 8) {
+        int16x8x2_t v = vld2q_s16(iq + 2 * k);
+        uint16x8_t ax = vreinterpretq_u16_s16(vabsq_s16(v.val[0]));
+        uint16x8_t ay = vreinterpretq_u16_s16(vabsq_s16(v.val[1]));
+        uint16x8_t hi = vmaxq_u16(ax, ay);
+        uint16x8_t lo = vminq_u16(ax, ay);
+        // octant fix-ups in modulo 2^16 arithmetic, like the scalar cast
+        uint16x8_t a = vcombine_u16(atan_q15(vget_low_u16(lo), vget_low_u16(hi)),
+                                    atan_q15(vget_high_u16(lo), vget_high_u16(hi)));
+
+        a = vbslq_u16(vcgtq_u16(ay, ax), vsubq_u16(vdupq_n_u16(BAM_QUARTER), a), a);
+        a = vbslq_u16(vcltq_s16(v.val[0], vdupq_n_s16(0)),
+                      vsubq_u16(vdupq_n_u16(BAM_HALF), a), a);
+        a = vbslq_u16(vcltq_s16(v.val[1], vdupq_n_s16(0)),
+                      vsubq_u16(vdupq_n_u16(0), a), a);
+        vst1q_s16(phase + k, vreinterpretq_s16_u16(a));
+    }
+    csi_phase_scalar(iq + 2 * k, phase + k, n - k);
+}
+#else
+void csi_amplitude(const int16_t *iq, uint16_t *amp, size_t n) {
+    csi_amplitude_scalar(iq, amp, n);
+}
+
+void csi_phase(const int16_t *iq, int16_t *phase, size_t n) {
+    csi_phase_scalar(iq, phase, n);
+}
+#endif
+
+void csi_phase_sanitize(int16_t *phase, size_t n) {
+    int32_t unwrapped[CSI_MAX_SUBCARRIERS];
+    int32_t last;
+    int64_t sum;
+    int64_t slope;
+    int32_t mean;
+
+    if (n < 2 || n > CSI_MAX_SUBCARRIERS) {
+        return;
+    }
+    last = phase[0];
+    sum = last;
+    unwrapped[0] = last;
+    for (size_t k = 1; k < n; ++k) {
+        // int16 difference wraps to the shortest step between neighbours
+        last += (int16_t)(phase[k] - phase[k - 1]);
+        unwrapped[k] = last;
+        sum += last;
+    }
+    mean = sum / (int64_t)n;
+    slope = last - phase[0];
+    for (size_t k = 0; k < n; ++k) {
+        // slope * (k - (n - 1) / 2), kept in integers
+        int64_t trend = slope * (2 * (int64_t)k - (int64_t)(n - 1)) /
+                        (int64_t)(2 * (n - 1));
+
+        phase[k] = (int16_t)(uint16_t)(unwrapped[k] - mean - trend);
+    }
+}
+
+int csi_features_init(struct csi_feature_acc *acc, uint16_t subcarriers) {
+    if (subcarriers == 0 || subcarriers > CSI_MAX_SUBCARRIERS ||
+        subcarriers % CSI_FEATURE_BINS) {
+        return -1;
+    }
+    memset(acc, 0, sizeof(*acc));
+    acc->subcarriers = subcarriers;
+    return 0;
+}
+
+int csi_features_add(struct csi_feature_acc *acc,
+                     const struct csi_frame_hdr *frame) {
+    uint16_t amp[CSI_MAX_SUBCARRIERS];
+    int16_t phase[CSI_MAX_SUBCARRIERS];
+    const int16_t *iq = (const int16_t *)(frame + 1);
+    size_t n = acc->subcarriers;
+
+    if (frame->subcarriers != n || frame->len < n * 2 * sizeof(int16_t) ||
+        acc->frames == UINT16_MAX) {
+        return -1;
+    }
+    csi_amplitude(iq, amp, n);
+    csi_phase(iq, phase, n);
+    csi_phase_sanitize(phase, n);
+    for (size_t k = 0; k < n; ++k) {
+        acc->amp_sum[k] += amp[k];
+        acc->amp_sq_sum[k] += (uint32_t)amp[k] * amp[k];
+        acc->phase_sum[k] += phase[k];
+        acc->phase_sq_sum[k] += (int32_t)phase[k] * phase[k];
+    }
+    acc->rssi_sum += frame->rssi;
+    acc->frames++;
+    return 0;
+}
+
+int csi_features_finish(const struct csi_feature_acc *acc,
+                        struct csi_features *out) {
+    size_t per_bin = acc->subcarriers / CSI_FEATURE_BINS;
+    uint64_t frames = acc->frames;
+    uint64_t total = 0;
+    uint64_t amp_mean;
+
+    if (frames == 0) {
+        return -1;
+    }
+    for (size_t k = 0; k < acc->subcarriers; ++k) {
+        total += acc->amp_sum[k];
+    }
+    amp_mean = total / (frames * acc->subcarriers);
+    amp_mean = amp_mean ? amp_mean : 1;
+
+    memset(out, 0, sizeof(*out));
+    out->version = CSI_FEATURES_VERSION;
+    out->frames = acc->frames;
+    out->subcarriers = acc->subcarriers;
+    out->rssi_mean = acc->rssi_sum / (int32_t)acc->frames;
+    out->amp_mean = amp_mean > UINT16_MAX ? UINT16_MAX : amp_mean;
+
+    for (size_t b = 0; b < CSI_FEATURE_BINS; ++b) {
+        uint64_t amp_sum = 0, amp_sq = 0, phase_sq = 0;
+        int64_t phase_sum = 0;
+        uint64_t samples = frames * per_bin;
+        int64_t phase_mean;
+        uint64_t amp_bin_mean, amp_var, phase_var;
+
+        for (size_t k = b * per_bin; k < (b + 1) * per_bin; ++k) {
+            amp_sum += acc->amp_sum[k];
+            amp_sq += acc->amp_sq_sum[k];
+            phase_sum += acc->phase_sum[k];
+            phase_sq += acc->phase_sq_sum[k];
+        }
+        amp_bin_mean = amp_sum / samples;
+        amp_var = amp_sq / samples - amp_bin_mean * amp_bin_mean;
+        phase_mean = phase_sum / (int64_t)samples;
+        phase_var = phase_sq / samples - (uint64_t)(phase_mean * phase_mean);
+        // E[x^2] - E[x]^2 may dip below zero through integer truncation
+        amp_var = (int64_t)amp_var < 0 ? 0 : amp_var;
+        phase_var = (int64_t)phase_var < 0 ? 0 : phase_var;
+
+        out->bins[b][CSI_BIN_AMP_MEAN] =
+            clamp16(((int64_t)amp_bin_mean << CSI_FEATURE_Q) / amp_mean);
+        out->bins[b][CSI_BIN_AMP_STD] =
+            clamp16(((int64_t)isqrt64(amp_var) << CSI_FEATURE_Q) / amp_mean);
+        out->bins[b][CSI_BIN_PHASE_MEAN] = clamp16(phase_mean);
+        out->bins[b][CSI_BIN_PHASE_STD] = clamp16(isqrt64(phase_var));
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Fixed-point CSI feature extraction.
+ *
+ * Turns a set of CSI frames into a fixed-length fingerprint so that only a
+ * few hundred bytes have to leave the TEE instead of every raw sample. All
+ * math is integer only. Angles are binary angles: a full turn is 65536, so
+ * an int16 wraps exactly like the phase it stores.
+ *
+ * csi_amplitude() and csi_phase() have NEON versions for AArch64, built only
+ * with CSI_USE_NEON (make NEON=1) until csi_bench has confirmed on AArch64
+ * hardware that they are bit-identical to the *_scalar() references used
+ * everywhere else.
+ */
+#ifndef CSI_FEATURES_H
+#define CSI_FEATURES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "csi_ring.h"
+
+#if defined(CSI_USE_NEON) && defined(__aarch64__) && defined(__ARM_NEON)
+#define CSI_FEATURES_NEON 1
+#endif
+
+#define CSI_FEATURES_VERSION    1
+// subcarriers are grouped into this many equally sized bins
+#define CSI_FEATURE_BINS        16
+// fixed-point scale of relative amplitudes
+#define CSI_FEATURE_Q           12
+
+enum csi_bin_feature {
+    CSI_BIN_AMP_MEAN,       // mean amplitude relative to the overall mean (Q12)
+    CSI_BIN_AMP_STD,        // amplitude standard deviation, same scale
+    CSI_BIN_PHASE_MEAN,     // mean sanitized phase (binary angle)
+    CSI_BIN_PHASE_STD,      // sanitized phase standard deviation
+    CSI_BIN_FEATURES,
+};
+
+/** Fingerprint as uploaded to the remote service, little-endian */
+struct csi_features {
+    uint16_t version;
+    uint16_t frames;
+    uint16_t subcarriers;
+    int16_t rssi_mean;
+    uint16_t amp_mean;      // mean amplitude over all subcarriers and frames
+    uint16_t reserved[3];
+    int16_t bins[CSI_FEATURE_BINS][CSI_BIN_FEATURES];
+};
+
+/** Running sums over frames, see csi_features_add() */
+struct csi_feature_acc {
+    uint16_t subcarriers;
+    uint16_t frames;
+    int32_t rssi_sum;
+    uint32_t amp_sum[CSI_MAX_SUBCARRIERS];
+    uint64_t amp_sq_sum[CSI_MAX_SUBCARRIERS];
+    int32_t phase_sum[CSI_MAX_SUBCARRIERS];
+    uint64_t phase_sq_sum[CSI_MAX_SUBCARRIERS];
+};
+
+/** Amplitude of 'n' I/Q pairs, max(hi, 7/8 hi + 1/2 lo) (error < 3.5%) */
+void csi_amplitude(const int16_t *iq, uint16_t *amp, size_t n);
+void csi_amplitude_scalar(const int16_t *iq, uint16_t *amp, size_t n);
+
+/** Phase of 'n' I/Q pairs as binary angle (error < 0.25 degree) */
+void csi_phase(const int16_t *iq, int16_t *phase, size_t n);
+void csi_phase_scalar(const int16_t *iq, int16_t *phase, size_t n);
+
+/**
+ * Unwrap 'n' phases across subcarriers and remove the linear slope and
+ * offset caused by sampling time and frequency offsets. Scalar only: the
+ * unwrap is a running sum across subcarriers, and the trend removal needs a
+ * truncating 64-bit division per subcarrier, which NEON does not have.
+ */
+void csi_phase_sanitize(int16_t *phase, size_t n);
+
+/** Start accumulating frames with 'subcarriers' subcarriers */
+int csi_features_init(struct csi_feature_acc *acc, uint16_t subcarriers);
+
+/** Add one frame, returns -1 if it does not match the accumulator */
+int csi_features_add(struct csi_feature_acc *acc,
+                     const struct csi_frame_hdr *frame);
+
+/** Compute the fingerprint of all frames added so far */
+int csi_features_finish(const struct csi_feature_acc *acc,
+                        struct csi_features *out);
+
+#endif // CSI_FEATURES_H
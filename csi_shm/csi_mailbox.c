@@ -0,0 +1,64 @@
+#include <string.h>
+
+#include "csi_mailbox.h"
+
+int csi_mailbox_init(struct csi_mailbox *mb, void *shm, size_t size,
+                     size_t payload_offset) {
+    if (payload_offset < CSI_MAILBOX_SIZE ||
+        payload_offset + CSI_RING_SLOT_SIZE > size) {
+        return -1;
+    }
+    mb->shm = shm;
+    mb->size = size;
+    mb->payload_offset = payload_offset;
+    memset(mb->shm, 0, CSI_MAILBOX_SIZE);
+    __atomic_store_n(&mb->shm[CSI_MAILBOX_STATUS_OFFSET], CSI_MAILBOX_STATUS_IDLE,
+                     __ATOMIC_RELEASE);
+    return 0;
+}
+
+uint32_t csi_mailbox_capacity(const struct csi_mailbox *mb) {
+    return (mb->size - mb->payload_offset) / CSI_RING_SLOT_SIZE;
+}
+
+struct csi_frame_hdr *csi_mailbox_frame(const struct csi_mailbox *mb, uint32_t i) {
+    return (struct csi_frame_hdr *)(mb->shm + mb->payload_offset +
+                                    (size_t)i * CSI_RING_SLOT_SIZE);
+}
+
+void csi_mailbox_request(struct csi_mailbox *mb) {
+    // a stale magic must not validate the next answer
+    mb->shm[CSI_MAILBOX_MAGIC_OFFSET] = 0;
+    __atomic_store_n(&mb->shm[CSI_MAILBOX_STATUS_OFFSET], CSI_MAILBOX_STATUS_REQUEST,
+                     __ATOMIC_RELEASE);
+}
+
+int csi_mailbox_poll_response(const struct csi_mailbox *mb, uint32_t *count) {
+    uint8_t status = __atomic_load_n(&mb->shm[CSI_MAILBOX_STATUS_OFFSET],
+                                     __ATOMIC_ACQUIRE);
+    uint32_t n;
+
+    if (status != CSI_MAILBOX_STATUS_DONE) {
+        return 0;
+    }
+    // shm is a byte array, memcpy() avoids the aliasing cast and compiles to one load
+    memcpy(&n, mb->shm + CSI_MAILBOX_COUNT_OFFSET, sizeof(n));
+    if (mb->shm[CSI_MAILBOX_MAGIC_OFFSET] != CSI_MAILBOX_MAGIC ||
+        n > csi_mailbox_capacity(mb)) {
+        return -1;
+    }
+    *count = n;
+    return 1;
+}
+
+int csi_mailbox_poll_request(const struct csi_mailbox *mb) {
+    return __atomic_load_n(&mb->shm[CSI_MAILBOX_STATUS_OFFSET], __ATOMIC_ACQUIRE) & 1;
+}
+
+void csi_mailbox_respond(struct csi_mailbox *mb, uint32_t count) {
+    memcpy(mb->shm + CSI_MAILBOX_COUNT_OFFSET, &count, sizeof(count));
+    mb->shm[CSI_MAILBOX_MAGIC_OFFSET] = CSI_MAILBOX_MAGIC;
+    // release publishes the samples, count and magic together with the status
+    __atomic_store_n(&mb->shm[CSI_MAILBOX_STATUS_OFFSET], CSI_MAILBOX_STATUS_DONE,
+                     __ATOMIC_RELEASE);
+}
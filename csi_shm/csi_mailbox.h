@@ -0,0 +1,64 @@
+/*
+ * Host-side model of the legacy single-shot CSI mailbox at the start of the
+ * CSI region, as driven by optee_os/core/pta/csi.c and the Nexmon VM (see
+ * "Testing" in the top level README):
+ *
+ *   1. requester (OP-TEE) writes an odd status byte at offset 0
+ *   2. responder (Nexmon) writes the frames, the sample count as u32 at
+ *      offset 8 and the magic byte at offset 7
+ *   3. responder sets the status byte to 2
+ *
+ * The status byte is the only synchronization, so it is written with release
+ * and read with acquire semantics. The legacy protocol does not fix where the
+ * samples go; here they follow the mailbox at 'payload_offset' as records of
+ * CSI_RING_SLOT_SIZE bytes (struct csi_frame_hdr plus I/Q payload), which
+ * keeps them comparable to ring frames. Set 'payload_offset' to whatever the
+ * PTA under test expects.
+ */
+#ifndef CSI_MAILBOX_H
+#define CSI_MAILBOX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "csi_ring.h"
+
+#define CSI_MAILBOX_SIZE            16
+#define CSI_MAILBOX_MAGIC           7
+#define CSI_MAILBOX_STATUS_IDLE     0
+#define CSI_MAILBOX_STATUS_REQUEST  1   // any odd value is a request
+#define CSI_MAILBOX_STATUS_DONE     2
+
+struct csi_mailbox {
+    uint8_t *shm;           // start of the CSI region
+    size_t size;            // bytes mapped at 'shm'
+    size_t payload_offset;  // first sample record, relative to 'shm'
+};
+
+/** Set up 'mb' over 'size' bytes at 'shm' and reset the status byte */
+int csi_mailbox_init(struct csi_mailbox *mb, void *shm, size_t size,
+                     size_t payload_offset);
+
+/** Number of sample records that fit behind the mailbox */
+uint32_t csi_mailbox_capacity(const struct csi_mailbox *mb);
+
+/** Return sample record 'i' */
+struct csi_frame_hdr *csi_mailbox_frame(const struct csi_mailbox *mb, uint32_t i);
+
+/** Requester: clear the previous answer and post a new request */
+void csi_mailbox_request(struct csi_mailbox *mb);
+
+/**
+ * Requester: return 1 and store the sample count in 'count' once the request
+ * was answered, 0 while it is pending and -1 if the answer has a wrong magic
+ * byte or claims more samples than fit into the region.
+ */
+int csi_mailbox_poll_response(const struct csi_mailbox *mb, uint32_t *count);
+
+/** Responder: return non-zero if a request is pending */
+int csi_mailbox_poll_request(const struct csi_mailbox *mb);
+
+/** Responder: answer the pending request with 'count' samples already written */
+void csi_mailbox_respond(struct csi_mailbox *mb, uint32_t count);
+
+#endif // CSI_MAILBOX_H
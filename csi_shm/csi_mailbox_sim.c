@@ -0,0 +1,379 @@
+// Simulator of both sides of the CSI shared memory protocol. A requester
+// thread plays the CSI PTA and a responder thread plays the Nexmon VM, both on
+// an anonymous shared mapping, so handoff latency and throughput of the legacy
+// mailbox and of the ring can be measured on any Linux machine. With a CSI
+// trace the responder serves recorded frames, optionally at their recorded
+// pace, for reproducible runs of the whole sample pipeline.
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "csi_mailbox.h"
+#include "csi_ring.h"
+#include "csi_synth.h"
+#include "csi_trace.h"
+
+#define DEFAULT_REQUESTS    1000
+#define DEFAULT_SAMPLES     64
+#define DEFAULT_SUBCARRIERS 64
+
+struct Params {
+    size_t requests;
+    uint32_t samples;           // frames per request
+    size_t subcarriers;
+    const char *trace;          // serve frames from this trace
+    double speed;               // trace pacing factor, 0 = as fast as possible
+    int ring;                   // use ring + batch request instead of the mailbox
+    int yield;                  // sched_yield() while waiting instead of spinning
+} params = {
+    .requests = DEFAULT_REQUESTS,
+    .samples = DEFAULT_SAMPLES,
+    .subcarriers = DEFAULT_SUBCARRIERS,
+};
+
+struct Sim {
+    struct csi_mailbox mb;
+    struct csi_ring_ctrl *ring;         // producer side
+    struct csi_ring_consumer consumer;  // requester (OP-TEE) side
+    struct csi_batch_request *batch;
+    int16_t *iq;                // payload template
+    struct csi_trace trace;
+    uint64_t trace_pos;         // next trace frame to serve
+    volatile int stop;
+};
+
+/** Parse params and save them to 'params' global struct */
+int parse_params(int argc, char **argv);
+/** Wait a little while polling shared memory */
+void relax(void);
+/** Fill 'frame' with sample 'seq' of the current request */
+void fill_frame(struct Sim *sim, struct csi_frame_hdr *frame, uint32_t seq);
+/** With a paced trace, wait until the next trace frame is due */
+void wait_trace_frame(const struct Sim *sim, uint64_t start_ns, uint64_t start_pos);
+/** Responder thread: answer requests until sim->stop is set */
+void *responder(void *arg);
+/** Requester: run one request, store latencies, return -1 on bad data */
+int request_mailbox(struct Sim *sim, uint8_t *buf, uint64_t *first_ns, uint64_t *done_ns);
+/** Ring only: also store request wait and capture time reported by the responder */
+int request_ring(struct Sim *sim, uint8_t *buf, uint64_t *first_ns, uint64_t *done_ns,
+                 uint64_t *wait_ns, uint64_t *capture_ns);
+/** Print min/median/p99/max of 'n' latencies, sorts 'lat' in place */
+void print_latency(const char *label, uint64_t *lat, size_t n);
+
+int main(int argc, char **argv) {
+    if (parse_params(argc, argv)) {
+        return -1;
+    }
+
+    struct Sim sim = { 0 };
+    if (params.trace) {
+        if (csi_trace_open(&sim.trace, params.trace) || sim.trace.frame_count == 0) {
+            fprintf(stderr, "%s: not a CSI trace or empty\n", params.trace);
+            return -1;
+        }
+        params.subcarriers = sim.trace.hdr->subcarriers;
+    }
+    void *shm = mmap(NULL, CSI_SHM_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shm == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    if (params.ring) {
+        if (csi_ring_consumer_init(&sim.consumer, shm, CSI_SHM_SIZE)) {
+            fprintf(stderr, "Cannot set up the ring\n");
+            return -1;
+        }
+        sim.ring = sim.consumer.ctrl;
+        sim.batch = csi_batch_from_shm(shm);
+    } else if (csi_mailbox_init(&sim.mb, shm, CSI_SHM_SIZE, CSI_MAILBOX_SIZE) ||
+               params.samples > csi_mailbox_capacity(&sim.mb)) {
+        fprintf(stderr, "%u samples do not fit behind the mailbox\n", params.samples);
+        return -1;
+    }
+
+    sim.iq = malloc(params.subcarriers * 2 * sizeof(int16_t));
+    if (sim.iq == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    csi_synth_frame(sim.iq, params.subcarriers, 0);
+    // requester side copy of every sample, like the PTA copying into TA memory
+    uint8_t *buf = malloc((size_t)params.samples * CSI_RING_SLOT_SIZE);
+    uint64_t *first = malloc(params.requests * sizeof(*first));
+    uint64_t *done = malloc(params.requests * sizeof(*done));
+    uint64_t *wait = malloc(params.requests * sizeof(*wait));
+    uint64_t *capture = malloc(params.requests * sizeof(*capture));
+    if (buf == NULL || first == NULL || done == NULL || wait == NULL || capture == NULL) {
+        perror("malloc");
+        return -1;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, responder, &sim)) {
+        perror("pthread_create");
+        return -1;
+    }
+
+    int errors = 0;
+    uint64_t start = csi_now_ns();
+    for (size_t r = 0; r < params.requests; ++r) {
+        if (params.ring) {
+            errors += request_ring(&sim, buf, &first[r], &done[r], &wait[r], &capture[r]) != 0;
+        } else {
+            errors += request_mailbox(&sim, buf, &first[r], &done[r]) != 0;
+        }
+    }
+    uint64_t elapsed = csi_now_ns() - start;
+    sim.stop = 1;
+    pthread_join(thread, NULL);
+
+    double bytes = (double)params.requests * params.samples *
+                   params.subcarriers * 2 * sizeof(int16_t);
+    printf("%s protocol, %zu requests x %u samples x %zu subcarriers, %s wait\n",
+           params.ring ? "ring" : "mailbox", params.requests, params.samples,
+           params.subcarriers, params.yield ? "yielding" : "spinning");
+    if (params.trace) {
+        printf("frames from %s (%u frames), %s\n", params.trace, sim.trace.frame_count,
+               params.speed > 0 ? "paced" : "as fast as possible");
+    }
+    printf("%-12s %10s %10s %10s %10s\n", "latency", "min", "median", "p99", "max");
+    if (params.ring) {
+        print_latency("request wait", wait, params.requests);
+        print_latency("capture", capture, params.requests);
+    }
+    print_latency("first data", first, params.requests);
+    print_latency("complete", done, params.requests);
+    printf("throughput: %.1f requests/s, %.1f MB/s I/Q, %d bad requests\n",
+           params.requests / (elapsed / 1e9), bytes / (elapsed / 1e3), errors);
+
+    free(capture);
+    free(wait);
+    free(done);
+    free(first);
+    free(buf);
+    free(sim.iq);
+    if (params.trace) {
+        csi_trace_close(&sim.trace);
+    }
+    munmap(shm, CSI_SHM_SIZE);
+    return errors ? 1 : 0;
+}
+
+int parse_params(int argc, char **argv) {
+    char usage_str[] = "%s [-R] [-y] [-n requests] [-s samples] [-c subcarriers]\n"
+                       "    [-T trace [-x speed]]\n"
+                       "  -R  use the ring and a batch request instead of the mailbox\n"
+                       "  -y  yield the CPU while waiting instead of spinning\n"
+                       "  -T  serve frames from a CSI trace, sets the subcarriers\n"
+                       "  -x  serve trace frames at their recorded pace times 'speed'\n";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "Ryn:s:c:T:x:")) != -1) {
+        switch (opt) {
+            case 'R':
+                params.ring = 1;
+                break;
+            case 'y':
+                params.yield = 1;
+                break;
+            case 'n':
+                params.requests = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                params.samples = strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                params.subcarriers = strtoul(optarg, NULL, 10);
+                break;
+            case 'T':
+                params.trace = optarg;
+                break;
+            case 'x':
+                params.speed = strtod(optarg, NULL);
+                break;
+            default:
+                fprintf(stderr, usage_str, argv[0]);
+                return -1;
+        }
+    }
+    if (params.requests == 0 || params.samples == 0 || params.samples > UINT16_MAX ||
+        params.subcarriers == 0 || params.subcarriers > CSI_MAX_SUBCARRIERS ||
+        params.speed < 0) {
+        fprintf(stderr, usage_str, argv[0]);
+        return -1;
+    }
+    return 0;
+}
+
+void relax(void) {
+    if (params.yield) {
+        sched_yield();
+    }
+}
+
+void fill_frame(struct Sim *sim, struct csi_frame_hdr *frame, uint32_t seq) {
+    size_t len = params.subcarriers * 2 * sizeof(int16_t);
+
+    if (params.trace) {
+        const struct csi_frame_hdr *src =
+            csi_trace_frame(&sim->trace, sim->trace_pos++ % sim->trace.frame_count);
+
+        memcpy(frame->mac, src->mac, sizeof(frame->mac));
+        frame->chanspec = src->chanspec;
+        frame->rssi = src->rssi;
+        memcpy(csi_frame_payload(frame), src + 1, len);
+    } else {
+        memcpy(csi_frame_payload(frame), sim->iq, len);
+    }
+    frame->seq = seq;
+    frame->timestamp_ns = csi_now_ns();
+    frame->len = len;
+    frame->subcarriers = params.subcarriers;
+}
+
+void wait_trace_frame(const struct Sim *sim, uint64_t start_ns, uint64_t start_pos) {
+    uint64_t due;
+
+    if (!params.trace || params.speed == 0) {
+        return;
+    }
+    due = start_ns + (csi_trace_loop_offset_ns(&sim->trace, sim->trace_pos) -
+                      csi_trace_loop_offset_ns(&sim->trace, start_pos)) / params.speed;
+    while (csi_now_ns() < due && !sim->stop) {
+        relax();
+    }
+}
+
+void *responder(void *arg) {
+    struct Sim *sim = arg;
+
+    while (!sim->stop) {
+        if (!params.ring) {
+            if (!csi_mailbox_poll_request(&sim->mb)) {
+                relax();
+                continue;
+            }
+            uint64_t start = csi_now_ns(), start_pos = sim->trace_pos;
+
+            for (uint32_t i = 0; i < params.samples; ++i) {
+                wait_trace_frame(sim, start, start_pos);
+                fill_frame(sim, csi_mailbox_frame(&sim->mb, i), i);
+            }
+            csi_mailbox_respond(&sim->mb, params.samples);
+            continue;
+        }
+
+        uint32_t id = csi_batch_pending(sim->batch);
+        if (id == 0) {
+            relax();
+            continue;
+        }
+        uint64_t start = csi_now_ns(), start_pos = sim->trace_pos;
+
+        csi_batch_start(sim->batch, start);
+        for (uint32_t i = 0; i < sim->batch->entries[0].samples && !sim->stop; ++i) {
+            struct csi_frame_hdr *frame;
+
+            wait_trace_frame(sim, start, start_pos);
+
+            while ((frame = csi_ring_produce_begin(sim->ring)) == NULL && !sim->stop) {
+                relax();
+            }
+            if (frame == NULL) {
+                break;
+            }
+            fill_frame(sim, frame, i);
+            frame->batch_id = id;
+            csi_ring_produce_commit(sim->ring);
+        }
+        sim->batch->entries[0].collected = sim->batch->entries[0].samples;
+        csi_batch_complete(sim->batch, id, CSI_BATCH_STATUS_DONE, csi_now_ns());
+    }
+    return NULL;
+}
+
+int request_mailbox(struct Sim *sim, uint8_t *buf, uint64_t *first_ns, uint64_t *done_ns) {
+    uint64_t start = csi_now_ns();
+    uint32_t count;
+    int ret, bad = 0;
+
+    csi_mailbox_request(&sim->mb);
+    while ((ret = csi_mailbox_poll_response(&sim->mb, &count)) == 0) {
+        relax();
+    }
+    *first_ns = csi_now_ns() - start;
+    if (ret < 0 || count != params.samples) {
+        bad = 1;
+        count = 0;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        const struct csi_frame_hdr *frame = csi_mailbox_frame(&sim->mb, i);
+        // read len once, the responder could change it under us
+        uint16_t len = __atomic_load_n(&frame->len, __ATOMIC_RELAXED);
+
+        if (len > CSI_FRAME_MAX_PAYLOAD) {
+            len = 0;
+            bad = 1;
+        }
+        memcpy(buf + (size_t)i * CSI_RING_SLOT_SIZE, frame, sizeof(*frame) + len);
+        bad |= frame->seq != i;
+    }
+    *done_ns = csi_now_ns() - start;
+    return bad ? -1 : 0;
+}
+
+int request_ring(struct Sim *sim, uint8_t *buf, uint64_t *first_ns, uint64_t *done_ns,
+                 uint64_t *wait_ns, uint64_t *capture_ns) {
+    struct csi_batch_entry entry = { .channel = 1, .bandwidth = 20, .samples = params.samples };
+    uint64_t start = csi_now_ns();
+    uint32_t id = csi_batch_submit(sim->batch, &entry, 1, 0);
+    uint32_t received = 0;
+    int bad = 0;
+
+    *first_ns = 0;
+    while (received < params.samples) {
+        struct csi_frame_hdr *frame = csi_ring_consume_begin(&sim->consumer);
+        uint16_t len;
+
+        if (frame == NULL) {
+            relax();
+            continue;
+        }
+        if (received == 0) {
+            *first_ns = csi_now_ns() - start;
+        }
+        // read len once, the producer could change it under us
+        len = __atomic_load_n(&frame->len, __ATOMIC_RELAXED);
+        if (len > CSI_FRAME_MAX_PAYLOAD) {
+            len = 0;
+            bad = 1;
+        }
+        memcpy(buf + (size_t)received * CSI_RING_SLOT_SIZE, frame, sizeof(*frame) + len);
+        bad |= frame->batch_id != id || frame->seq != received;
+        csi_ring_consume_end(&sim->consumer);
+        ++received;
+    }
+    while (csi_batch_status(sim->batch, id) == CSI_BATCH_STATUS_PENDING) {
+        relax();
+    }
+    *done_ns = csi_now_ns() - start;
+    *wait_ns = sim->batch->started_ns - start;
+    *capture_ns = sim->batch->completed_ns - sim->batch->started_ns;
+    return bad ? -1 : 0;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+void print_latency(const char *label, uint64_t *lat, size_t n) {
+    qsort(lat, n, sizeof(*lat), cmp_u64);
+    printf("%-12s %7.1f us %7.1f us %7.1f us %7.1f us\n", label, lat[0] / 1e3,
+           lat[n / 2] / 1e3, lat[n * 99 / 100] / 1e3, lat[n - 1] / 1e3);
+}
@@ -0,0 +1,453 @@
+// Userspace CSI producer for the Nexmon VM. Writes recorded or synthetic
+// frames into the CSI ring at a fixed rate, or replays a CSI trace with its
+// original timing, and reports how well the consumer keeps up. Works on the
+// ipcshmem device of the CSI region inside the VM as well as on a plain file,
+// so consumers can be load tested on any Linux machine.
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "csi_ring.h"
+#include "csi_synth.h"
+#include "csi_trace.h"
+
+#define DEFAULT_SUBCARRIERS 64
+#define DEFAULT_RATE        100
+#define STALL_POLL_NS       50000
+
+struct Params {
+    const char *shm_path;
+    const char *file;
+    const char *trace;          // replay this trace instead of 'file'
+    const char *record;         // write every produced frame to this trace
+    size_t subcarriers;
+    unsigned long rate;         // frames per second, 0 = as fast as possible
+    double speed;               // trace playback speed, 0 = as fast as possible
+    unsigned long frames;       // 0 = until interrupted
+    unsigned long interval;     // seconds between reports
+    int init;                   // lay out the ring ourselves (no OP-TEE)
+    int window;                 // with init: start in window mode
+    int drop;                   // drop frames on a full ring instead of waiting
+    int rate_set;               // -r given, pace a trace at 'rate' as well
+    int frames_set;             // -n given, otherwise a trace is played once
+} params = {
+    .subcarriers = DEFAULT_SUBCARRIERS,
+    .rate = DEFAULT_RATE,
+    .speed = 1.0,
+    .interval = 1,
+};
+
+struct Stats {
+    unsigned long produced;
+    unsigned long stalls;       // times the ring was full
+    uint64_t stall_ns;          // time spent waiting for a free slot
+    unsigned long wakeups;      // consumer was asleep on the doorbell
+    uint32_t max_lag;           // most frames queued at once
+    uint64_t max_lag_ns;        // age of the oldest queued frame
+};
+
+static volatile sig_atomic_t stop;
+static struct csi_trace trace;
+
+/** Parse params and save them to 'params' global struct */
+int parse_params(int argc, char **argv);
+/** Map the CSI region from params.shm_path, NULL on error */
+void *map_region(void);
+/** Load frame payloads from params.file or synthesize them, return count */
+size_t load_payloads(int16_t **payloads);
+/** Open params.trace and adopt its shape, returns 0 or -1 */
+int open_trace(void);
+/** Sleep until monotonic time 'deadline_ns' */
+void sleep_until(uint64_t deadline_ns);
+/** Record consumer lag of 'ring' at time 'now' into 'stats' */
+void sample_lag(struct csi_ring_ctrl *ring, uint64_t now, struct Stats *stats);
+/** Add counters of 'part' to 'total' */
+void merge_stats(struct Stats *total, const struct Stats *part);
+/** Print one report line for 'stats' collected over 'ns' nanoseconds */
+void report(const char *label, const struct Stats *stats, uint32_t dropped,
+            uint64_t ns);
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+int main(int argc, char **argv) {
+    if (parse_params(argc, argv)) {
+        return -1;
+    }
+
+    int16_t *payloads = NULL;
+    size_t payload_count = 0;
+    if (params.trace) {
+        if (open_trace()) {
+            return -1;
+        }
+    } else if ((payload_count = load_payloads(&payloads)) == 0) {
+        return -1;
+    }
+    size_t payload_bytes = params.subcarriers * 2 * sizeof(int16_t);
+
+    struct csi_trace_writer writer = { 0 };
+    if (params.record &&
+        csi_trace_create(&writer, params.record, params.subcarriers,
+                         params.trace ? trace.hdr->channel : 0,
+                         params.trace ? trace.hdr->bandwidth : 0)) {
+        perror(params.record);
+        return -1;
+    }
+
+    void *shm = map_region();
+    if (shm == NULL) {
+        return -1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    struct csi_ring_ctrl *ring;
+    if (params.init) {
+        // stand in for OP-TEE, which owns the ring
+        struct csi_ring_consumer owner;
+
+        if (csi_ring_consumer_init(&owner, shm, CSI_SHM_SIZE)) {
+            fprintf(stderr, "Cannot set up the ring\n");
+            return -1;
+        }
+        csi_ring_set_mode(&owner, params.window ? CSI_RING_MODE_WINDOW : CSI_RING_MODE_STREAM);
+        ring = owner.ctrl;
+    } else {
+        ring = csi_ring_from_shm(shm);
+        printf("Waiting for the consumer to set up the ring...\n");
+        while (!csi_ring_valid(ring) && !stop) {
+            usleep(100000);
+        }
+    }
+    if (params.trace && !params.rate_set) {
+        printf("ring: %u slots, %s mode, %u trace frames at %.2fx, %s on full ring\n",
+               ring->slot_count, ring->mode == CSI_RING_MODE_WINDOW ? "window" : "stream",
+               trace.frame_count, params.speed, params.drop ? "drop" : "wait");
+    } else {
+        printf("ring: %u slots, %s mode, %lu frames/s, %s on full ring\n",
+               ring->slot_count, ring->mode == CSI_RING_MODE_WINDOW ? "window" : "stream",
+               params.rate, params.drop ? "drop" : "wait");
+    }
+
+    struct Stats total = { 0 }, interval = { 0 };
+    uint32_t dropped_start = ring->dropped, dropped_interval = ring->dropped;
+    uint64_t period_ns = params.rate ? 1000000000 / params.rate : 0;
+    uint64_t start = csi_now_ns(), next_report = start + params.interval * 1000000000;
+    uint64_t interval_start = start;
+
+    for (unsigned long i = 0; !stop && (params.frames == 0 || i < params.frames); ++i) {
+        if (params.trace && !params.rate_set) {
+            if (params.speed > 0) {
+                sleep_until(start + (uint64_t)(csi_trace_loop_offset_ns(&trace, i) / params.speed));
+            }
+        } else if (period_ns) {
+            sleep_until(start + i * period_ns);
+        }
+
+        struct csi_frame_hdr *frame = csi_ring_produce_begin(ring);
+        if (frame == NULL) {
+            uint64_t stall_start = csi_now_ns();
+
+            interval.stalls++;
+            while (!params.drop && !stop && (frame = csi_ring_produce_begin(ring)) == NULL) {
+                sleep_until(csi_now_ns() + STALL_POLL_NS);
+            }
+            interval.stall_ns += csi_now_ns() - stall_start;
+            if (stop) {
+                break;
+            }
+        }
+        if (frame == NULL) {
+            csi_ring_produce_drop(ring);
+        } else {
+            // everything but seq and the slot lock
+            size_t meta = offsetof(struct csi_frame_hdr, reserved) -
+                          offsetof(struct csi_frame_hdr, timestamp_ns);
+
+            if (params.trace) {
+                const struct csi_frame_hdr *src = csi_trace_frame(&trace, i % trace.frame_count);
+
+                memcpy(&frame->timestamp_ns, &src->timestamp_ns, meta);
+                memcpy(csi_frame_payload(frame), src + 1, payload_bytes);
+                // batches of the recording session mean nothing here
+                frame->batch_entry = 0;
+                frame->batch_id = 0;
+            } else {
+                memset(&frame->timestamp_ns, 0, meta);
+                frame->rssi = -50;
+                memcpy(csi_frame_payload(frame),
+                       payloads + (i % payload_count) * params.subcarriers * 2, payload_bytes);
+            }
+            frame->seq = i;
+            frame->timestamp_ns = csi_now_ns();
+            frame->len = payload_bytes;
+            frame->subcarriers = params.subcarriers;
+            csi_ring_produce_commit(ring);
+            interval.produced++;
+            // the slot stays untouched until we produce into it again
+            if (params.record && csi_trace_append(&writer, frame)) {
+                perror(params.record);
+                stop = 1;
+            }
+            if (csi_ring_producer_should_ring(ring)) {
+                // the IPC hypercall is not available from EL0, the Nexmon
+                // kernel driver has to ring the doorbell for us
+                interval.wakeups++;
+            }
+        }
+
+        uint64_t now = csi_now_ns();
+        sample_lag(ring, now, &interval);
+        if (now >= next_report) {
+            report("interval", &interval, ring->dropped - dropped_interval, now - interval_start);
+            merge_stats(&total, &interval);
+            memset(&interval, 0, sizeof(interval));
+            dropped_interval = ring->dropped;
+            interval_start = now;
+            next_report = now + params.interval * 1000000000;
+        }
+    }
+
+    merge_stats(&total, &interval);
+    report("total", &total, ring->dropped - dropped_start, csi_now_ns() - start);
+
+    if (params.record && csi_trace_finish(&writer)) {
+        perror(params.record);
+    }
+    if (params.trace) {
+        csi_trace_close(&trace);
+    }
+    munmap(shm, CSI_SHM_SIZE);
+    free(payloads);
+    return 0;
+}
+
+int parse_params(int argc, char **argv) {
+    char usage_str[] = "%s -m shm [-i] [-w] [-d] [-f raw_iq_file] [-s subcarriers]\n"
+                       "    [-T trace [-x speed]] [-o trace] [-r frames_per_s] [-n frames]\n"
+                       "    [-t report_interval_s]\n"
+                       "  -m  ipcshmem device of the CSI region, or a file for host-side tests\n"
+                       "  -i  set up the ring instead of waiting for OP-TEE to do it\n"
+                       "  -w  with -i, put the ring into window mode\n"
+                       "  -d  drop frames on a full ring instead of waiting\n"
+                       "  -T  replay a CSI trace with its recorded timing\n"
+                       "  -x  trace playback speed factor, 0 plays as fast as possible\n"
+                       "  -o  record every frame written to the ring into a CSI trace\n"
+                       "  -r  0 writes as fast as possible, overrides the trace timing\n"
+                       "  -n  0 runs until interrupted, a trace is played once by default\n";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:iwdf:s:T:x:o:r:n:t:")) != -1) {
+        switch (opt) {
+            case 'm':
+                params.shm_path = optarg;
+                break;
+            case 'i':
+                params.init = 1;
+                break;
+            case 'w':
+                params.window = 1;
+                break;
+            case 'd':
+                params.drop = 1;
+                break;
+            case 'f':
+                params.file = optarg;
+                break;
+            case 's':
+                params.subcarriers = strtoul(optarg, NULL, 10);
+                break;
+            case 'T':
+                params.trace = optarg;
+                break;
+            case 'x':
+                params.speed = strtod(optarg, NULL);
+                break;
+            case 'o':
+                params.record = optarg;
+                break;
+            case 'r':
+                params.rate = strtoul(optarg, NULL, 10);
+                params.rate_set = 1;
+                break;
+            case 'n':
+                params.frames = strtoul(optarg, NULL, 10);
+                params.frames_set = 1;
+                break;
+            case 't':
+                params.interval = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, usage_str, argv[0]);
+                return -1;
+        }
+    }
+    if (params.shm_path == NULL ||
+        params.subcarriers == 0 || params.subcarriers > CSI_MAX_SUBCARRIERS ||
+        params.interval == 0 || params.rate > 1000000000 || params.speed < 0) {
+        fprintf(stderr, usage_str, argv[0]);
+        return -1;
+    }
+    return 0;
+}
+
+void *map_region(void) {
+    struct stat st;
+    void *shm;
+    int fd;
+
+    // arm64 maps non-RAM through /dev/mem as Device memory, where the
+    // unaligned copies and exclusive loads/stores of the ring can fault
+    if (strcmp(params.shm_path, "/dev/mem") == 0) {
+        fprintf(stderr, "/dev/mem gives a Device mapping, use the ipcshmem device "
+                        "of the CSI region\n");
+        return NULL;
+    }
+    fd = open(params.shm_path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || fstat(fd, &st)) {
+        perror(params.shm_path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    if (S_ISREG(st.st_mode) && st.st_size < CSI_SHM_SIZE &&
+        ftruncate(fd, CSI_SHM_SIZE)) {
+        perror(params.shm_path);
+        close(fd);
+        return NULL;
+    }
+    // the ipcshmem device maps the region from offset 0 as Normal memory
+    shm = mmap(NULL, CSI_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    return shm;
+}
+
+size_t load_payloads(int16_t **payloads) {
+    size_t frame_values = params.subcarriers * 2;
+    size_t count = 64;
+    FILE *f = NULL;
+    struct stat st;
+
+    if (params.file) {
+        if ((f = fopen(params.file, "rb")) == NULL || fstat(fileno(f), &st)) {
+            perror(params.file);
+            return 0;
+        }
+        count = st.st_size / (frame_values * sizeof(int16_t));
+        if (count == 0) {
+            fprintf(stderr, "%s: shorter than one frame\n", params.file);
+            fclose(f);
+            return 0;
+        }
+    }
+    *payloads = malloc(count * frame_values * sizeof(int16_t));
+    if (*payloads == NULL) {
+        perror("malloc");
+        count = 0;
+    } else if (f) {
+        if (fread(*payloads, frame_values * sizeof(int16_t), count, f) != count) {
+            perror(params.file);
+            free(*payloads);
+            count = 0;
+        }
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            csi_synth_frame(*payloads + i * frame_values, params.subcarriers, i);
+        }
+    }
+    if (f) {
+        fclose(f);
+    }
+    return count;
+}
+
+int open_trace(void) {
+    if (csi_trace_open(&trace, params.trace) || trace.frame_count == 0) {
+        fprintf(stderr, "%s: not a CSI trace or empty\n", params.trace);
+        return -1;
+    }
+    params.subcarriers = trace.hdr->subcarriers;
+    if (!params.frames_set) {
+        params.frames = trace.frame_count;
+    }
+    return 0;
+}
+
+
+void sleep_until(uint64_t deadline_ns) {
+    uint64_t now = csi_now_ns();
+    struct timespec ts;
+
+    if (deadline_ns <= now) {
+        return;
+    }
+    // relative sleep, the frame clock need not be CLOCK_MONOTONIC
+    ts.tv_sec = (deadline_ns - now) / 1000000000;
+    ts.tv_nsec = (deadline_ns - now) % 1000000000;
+    while (nanosleep(&ts, &ts) && errno == EINTR && !stop) {
+    }
+}
+
+void sample_lag(struct csi_ring_ctrl *ring, uint64_t now, struct Stats *stats) {
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t lag;
+
+    // the window consumer does not move tail, there is no queue to measure
+    if (__atomic_load_n(&ring->mode, __ATOMIC_ACQUIRE) == CSI_RING_MODE_WINDOW) {
+        return;
+    }
+    lag = csi_ring_distance(ring, ring->head, tail);
+    if (lag > stats->max_lag) {
+        stats->max_lag = lag;
+    }
+    if (lag) {
+        // a queued slot is not rewritten before the consumer releases it
+        uint64_t oldest = csi_ring_slot(ring, tail)->timestamp_ns;
+
+        if (now > oldest && now - oldest > stats->max_lag_ns) {
+            stats->max_lag_ns = now - oldest;
+        }
+    }
+}
+
+void merge_stats(struct Stats *total, const struct Stats *part) {
+    total->produced += part->produced;
+    total->stalls += part->stalls;
+    total->stall_ns += part->stall_ns;
+    total->wakeups += part->wakeups;
+    if (part->max_lag > total->max_lag) {
+        total->max_lag = part->max_lag;
+    }
+    if (part->max_lag_ns > total->max_lag_ns) {
+        total->max_lag_ns = part->max_lag_ns;
+    }
+}
+
+void report(const char *label, const struct Stats *stats, uint32_t dropped,
+            uint64_t ns) {
+    double seconds = ns / 1e9;
+
+    printf("%-8s %8lu frames %9.1f/s  stalls %lu (%.1f ms)  dropped %u  "
+           "wakeups %lu  max lag %u frames / %.1f ms\n",
+           label, stats->produced, seconds > 0 ? stats->produced / seconds : 0.0,
+           stats->stalls, stats->stall_ns / 1e6, dropped, stats->wakeups,
+           stats->max_lag, stats->max_lag_ns / 1e6);
+    fflush(stdout);
+}
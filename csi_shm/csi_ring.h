@@ -0,0 +1,615 @@
+/*
+ * CSI shared memory ring between the Nexmon VM (producer) and OP-TEE
+ * (consumer).
+ *
+ * The region is the one described by shmem_id 1 in
+ * rpi4-ws/configs/rpi4-single-vTEE-dual-linux/config.c (0x09000000, 8 MiB).
+ * Its first 16 bytes are left to the header of the original single-shot
+ * mailbox (status byte at offset 0, magic at offset 7, sample count at
+ * offset 8) and the ring lives behind them. The legacy protocol does not
+ * define where its samples go and the ring reserves no room for them, so a
+ * region is driven by one protocol at a time.
+ *
+ * The ring is single-producer/single-consumer. head is only written by the
+ * producer, tail only by the consumer, and each of them sits on its own cache
+ * line. Both indices run in [0, 2 * slot_count) so that a full ring can be
+ * told apart from an empty one without wasting a slot.
+ *
+ * The control block and the slots are writable by the Nexmon VM, so OP-TEE
+ * must not trust anything it reads from them. The consumer side therefore
+ * works on a struct csi_ring_consumer holding its own copy of the geometry
+ * and of tail, and checks every head it reads before forming a slot address.
+ *
+ * In window mode (csi_ring_set_mode()) the producer never waits for the
+ * consumer and overwrites the oldest slot instead, which turns the ring into a
+ * rolling cache of the most recent, timestamped frames. Each slot carries a
+ * sequence lock so the consumer can detect frames overwritten under it.
+ *
+ * Everything here is header-only and depends on nothing but the compiler's
+ * __atomic builtins, so the same file can be built into OP-TEE core, the
+ * Nexmon VM userspace and host-side tools.
+ */
+#ifndef CSI_RING_H
+#define CSI_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CSI_SHM_PHYS_ADDR           0x09000000
+#define CSI_SHM_SIZE                0x00800000
+
+// legacy single-shot mailbox, see "Testing" in the top level README
+#define CSI_MAILBOX_STATUS_OFFSET   0
+#define CSI_MAILBOX_MAGIC_OFFSET    7
+#define CSI_MAILBOX_COUNT_OFFSET    8
+
+#define CSI_RING_CACHE_LINE         64
+// ring control block, placed right behind the legacy mailbox
+#define CSI_RING_CTRL_OFFSET        CSI_RING_CACHE_LINE
+// first slot, relative to the ring control block
+#define CSI_RING_DATA_OFFSET        (0x1000 - CSI_RING_CTRL_OFFSET)
+// batched collection request, between ring control block and data
+#define CSI_BATCH_OFFSET            0x200
+
+// Doorbells: CROSSCON Hypervisor IPC notifications on shmem_id 1. Ringing the
+// IPC (hypercall CSI_HC_IPC with the index of the region in the caller's
+// vm_config ipcs[] list) raises the interrupt the peer declared for it.
+#define CSI_HC_IPC                  1
+#define CSI_DOORBELL_IRQ_NEXMON     (0x14 + 32)
+#define CSI_DOORBELL_IRQ_OPTEE      (0x16 + 32)
+
+#define CSI_RING_MAGIC              0x52495343 // "CSIR"
+#define CSI_RING_VERSION            4
+
+// consumer selected operating mode, see csi_ring_set_mode()
+#define CSI_RING_MODE_STREAM        0   // producer stops on a full ring
+#define CSI_RING_MODE_WINDOW        1   // producer overwrites the oldest frame
+
+// default freshness limit for frames taken from the window
+#define CSI_WINDOW_DEFAULT_MAX_AGE_NS   (5ULL * 1000 * 1000 * 1000)
+
+// Nexmon reports I/Q as int16 pairs, 256 subcarriers cover 80 MHz
+#define CSI_MAX_SUBCARRIERS         256
+#define CSI_FRAME_MAX_PAYLOAD       (CSI_MAX_SUBCARRIERS * 2 * sizeof(int16_t))
+#define CSI_RING_SLOT_SIZE          (sizeof(struct csi_frame_hdr) + CSI_FRAME_MAX_PAYLOAD)
+
+/** Metadata of one CSI frame, followed by 'len' bytes of I/Q payload */
+struct csi_frame_hdr {
+    uint32_t seq;           // producer frame counter
+    uint32_t lock;          // odd while the producer writes the slot
+    uint64_t timestamp_ns;  // capture time, see csi_clock_ns()
+    uint16_t len;           // payload bytes
+    uint16_t subcarriers;   // number of I/Q pairs in payload
+    uint8_t mac[6];         // transmitter MAC address
+    uint16_t chanspec;      // Broadcom chanspec (channel + bandwidth)
+    uint8_t core;           // receiving RF core
+    uint8_t spatial_stream;
+    int8_t rssi;
+    uint8_t batch_entry;    // index into csi_batch_request.entries
+    uint32_t batch_id;      // request the frame was captured for, 0 if none
+    uint8_t reserved[CSI_RING_CACHE_LINE - 36];
+};
+
+_Static_assert(sizeof(struct csi_frame_hdr) == CSI_RING_CACHE_LINE,
+               "CSI frame header must fill exactly one cache line");
+
+struct csi_ring_ctrl {
+    // written once by csi_ring_init()
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved0;
+    uint32_t slot_size;
+    uint32_t slot_count;
+    uint32_t data_offset;   // first slot, relative to this struct
+    uint32_t generation;    // bumped by every csi_ring_init()
+    uint8_t pad0[CSI_RING_CACHE_LINE - 6 * sizeof(uint32_t)];
+
+    // producer owned
+    uint32_t head;
+    uint32_t dropped;       // frames the producer discarded on a full ring
+    uint8_t pad1[CSI_RING_CACHE_LINE - 2 * sizeof(uint32_t)];
+
+    // consumer owned
+    uint32_t tail;
+    uint32_t consumer_waiting;  // consumer sleeps until the doorbell rings
+    uint32_t mode;              // CSI_RING_MODE_*
+    uint8_t pad2[CSI_RING_CACHE_LINE - 3 * sizeof(uint32_t)];
+};
+
+_Static_assert(sizeof(struct csi_ring_ctrl) <= CSI_RING_DATA_OFFSET,
+               "CSI ring control block overlaps its data");
+
+#if defined(__aarch64__)
+/**
+ * Nanoseconds of the ARM generic timer. The virtual counter is shared by all
+ * VMs on the board (the hypervisor leaves CNTVOFF_EL2 at 0), so timestamps
+ * taken in the Nexmon VM can be compared against this clock in OP-TEE.
+ */
+static inline uint64_t csi_clock_ns(void) {
+    uint64_t cnt, freq;
+
+    __asm__ volatile("isb; mrs %0, cntvct_el0" : "=r"(cnt));
+    __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+    return (uint64_t)((unsigned __int128)cnt * 1000000000 / freq);
+}
+#endif
+
+/** Return ring control block inside the shared region starting at 'shm' */
+static inline struct csi_ring_ctrl *csi_ring_from_shm(void *shm) {
+    return (struct csi_ring_ctrl *)((uint8_t *)shm + CSI_RING_CTRL_OFFSET);
+}
+
+/** Number of slots csi_ring_init() lays out in 'shm_size' bytes */
+static inline uint32_t csi_ring_slots_for(size_t shm_size) {
+    size_t used = CSI_RING_CTRL_OFFSET + CSI_RING_DATA_OFFSET;
+
+    return shm_size > used ? (shm_size - used) / CSI_RING_SLOT_SIZE : 0;
+}
+
+/**
+ * Lay out a ring over 'shm_size' bytes of shared memory. Must be called by
+ * exactly one side (OP-TEE) before the other one attaches. A consumer uses
+ * csi_ring_consumer_init() instead.
+ */
+static inline struct csi_ring_ctrl *csi_ring_init(void *shm, size_t shm_size) {
+    struct csi_ring_ctrl *ring = csi_ring_from_shm(shm);
+
+    // invalidate first so that an attached peer stops using stale geometry
+    __atomic_store_n(&ring->magic, 0, __ATOMIC_RELEASE);
+    ring->version = CSI_RING_VERSION;
+    ring->slot_size = CSI_RING_SLOT_SIZE;
+    ring->slot_count = csi_ring_slots_for(shm_size);
+    ring->data_offset = CSI_RING_DATA_OFFSET;
+    ring->generation++;
+    ring->head = 0;
+    ring->dropped = 0;
+    ring->tail = 0;
+    ring->consumer_waiting = 0;
+    ring->mode = CSI_RING_MODE_STREAM;
+    __atomic_store_n(&ring->magic, CSI_RING_MAGIC, __ATOMIC_RELEASE);
+    return ring;
+}
+
+/** Return non-zero if 'ring' was set up by a compatible csi_ring_init() */
+static inline int csi_ring_valid(const struct csi_ring_ctrl *ring) {
+    return __atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) == CSI_RING_MAGIC &&
+           ring->version == CSI_RING_VERSION &&
+           ring->slot_size == CSI_RING_SLOT_SIZE &&
+           ring->slot_count > 0;
+}
+
+/**
+ * Consumer view of a ring. Everything the consumer needs to compute addresses
+ * is kept here, outside the memory the producer can write.
+ */
+struct csi_ring_consumer {
+    struct csi_ring_ctrl *ctrl;
+    uint8_t *data;          // first slot
+    uint32_t slot_count;
+    uint32_t tail;          // authoritative, ctrl->tail is only a copy for the producer
+};
+
+/**
+ * Consumer: attach to the ring in 'shm_size' bytes at 'shm' that was laid
+ * out before, e.g. by another consumer. The geometry is derived from
+ * 'shm_size' and the shared copy only checked against it. Returns 0, or -1 if
+ * there is no compatible ring.
+ */
+static inline int csi_ring_consumer_attach(struct csi_ring_consumer *c, void *shm,
+                                           size_t shm_size) {
+    struct csi_ring_ctrl *ring = csi_ring_from_shm(shm);
+    uint32_t slots = csi_ring_slots_for(shm_size);
+
+    if (slots == 0 || !csi_ring_valid(ring) || ring->slot_count != slots ||
+        ring->data_offset != CSI_RING_DATA_OFFSET) {
+        return -1;
+    }
+    c->ctrl = ring;
+    c->data = (uint8_t *)ring + CSI_RING_DATA_OFFSET;
+    c->slot_count = slots;
+    c->tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    if (c->tail >= 2 * slots) {
+        return -1;
+    }
+    return 0;
+}
+
+/** Consumer: lay out a ring with csi_ring_init() and attach to it */
+static inline int csi_ring_consumer_init(struct csi_ring_consumer *c, void *shm,
+                                         size_t shm_size) {
+    csi_ring_init(shm, shm_size);
+    return csi_ring_consumer_attach(c, shm, shm_size);
+}
+
+/** Number of frames ready for the consumer, 'head' and 'tail' in [0, 2n) */
+static inline uint32_t csi_ring_distance(const struct csi_ring_ctrl *ring,
+                                         uint32_t head, uint32_t tail) {
+    return head >= tail ? head - tail : head + 2 * ring->slot_count - tail;
+}
+
+static inline uint32_t csi_ring_next(const struct csi_ring_ctrl *ring,
+                                     uint32_t idx) {
+    return idx + 1 == 2 * ring->slot_count ? 0 : idx + 1;
+}
+
+static inline uint32_t csi_ring_prev(const struct csi_ring_ctrl *ring,
+                                     uint32_t idx) {
+    return idx == 0 ? 2 * ring->slot_count - 1 : idx - 1;
+}
+
+/** Return frame header stored in slot addressed by ring index 'idx' */
+static inline struct csi_frame_hdr *csi_ring_slot(struct csi_ring_ctrl *ring,
+                                                  uint32_t idx) {
+    uint32_t slot = idx < ring->slot_count ? idx : idx - ring->slot_count;
+    return (struct csi_frame_hdr *)((uint8_t *)ring + ring->data_offset +
+                                    (size_t)slot * ring->slot_size);
+}
+
+/** Return payload following frame header 'frame' */
+static inline void *csi_frame_payload(struct csi_frame_hdr *frame) {
+    return frame + 1;
+}
+
+/** Frames currently queued, producer side, see csi_ring_consumer_count() */
+static inline uint32_t csi_ring_count(struct csi_ring_ctrl *ring) {
+    return csi_ring_distance(ring,
+                             __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE),
+                             __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * Producer: return next free slot or NULL if the ring is full. The slot only
+ * becomes visible to the consumer after csi_ring_produce_commit().
+ */
+static inline struct csi_frame_hdr *csi_ring_produce_begin(struct csi_ring_ctrl *ring) {
+    uint32_t head = ring->head;
+    struct csi_frame_hdr *frame;
+
+    if (__atomic_load_n(&ring->mode, __ATOMIC_ACQUIRE) != CSI_RING_MODE_WINDOW) {
+        uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+        if (csi_ring_distance(ring, head, tail) == ring->slot_count) {
+            return NULL;
+        }
+    }
+    frame = csi_ring_slot(ring, head);
+    // odd lock tells window readers that the slot is being rewritten
+    __atomic_store_n(&frame->lock, frame->lock + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return frame;
+}
+
+/** Producer: publish slot returned by csi_ring_produce_begin() */
+static inline void csi_ring_produce_commit(struct csi_ring_ctrl *ring) {
+    struct csi_frame_hdr *frame = csi_ring_slot(ring, ring->head);
+
+    __atomic_store_n(&frame->lock, frame->lock + 1, __ATOMIC_RELEASE);
+    // release orders the frame contents before the new head
+    __atomic_store_n(&ring->head, csi_ring_next(ring, ring->head),
+                     __ATOMIC_RELEASE);
+}
+
+/** Producer: account for a frame that could not be queued */
+static inline void csi_ring_produce_drop(struct csi_ring_ctrl *ring) {
+    __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+}
+
+/** Consumer: return frame header in the slot addressed by 'idx' < 2n */
+static inline struct csi_frame_hdr *csi_ring_consumer_slot(const struct csi_ring_consumer *c,
+                                                           uint32_t idx) {
+    uint32_t slot = idx < c->slot_count ? idx : idx - c->slot_count;
+
+    return (struct csi_frame_hdr *)(c->data + (size_t)slot * CSI_RING_SLOT_SIZE);
+}
+
+/**
+ * Consumer: load head, or return 2n if the producer stored something outside
+ * [0, 2n). Callers treat such a ring as empty.
+ */
+static inline uint32_t csi_ring_consumer_head(const struct csi_ring_consumer *c) {
+    // acquire pairs with the release in csi_ring_produce_commit()
+    uint32_t head = __atomic_load_n(&c->ctrl->head, __ATOMIC_ACQUIRE);
+
+    return head < 2 * c->slot_count ? head : 2 * c->slot_count;
+}
+
+/** Consumer: frames currently queued, 0 if head is out of range */
+static inline uint32_t csi_ring_consumer_count(const struct csi_ring_consumer *c) {
+    uint32_t head = csi_ring_consumer_head(c);
+    uint32_t count;
+
+    if (head == 2 * c->slot_count) {
+        return 0;
+    }
+    count = head >= c->tail ? head - c->tail : head + 2 * c->slot_count - c->tail;
+    // a producer never gets more than n ahead
+    return count <= c->slot_count ? count : 0;
+}
+
+/**
+ * Consumer: return oldest queued frame or NULL if the ring is empty. The
+ * frame lives in producer writable memory, copy 'len' once and check it
+ * against CSI_FRAME_MAX_PAYLOAD before using the payload.
+ */
+static inline struct csi_frame_hdr *csi_ring_consume_begin(struct csi_ring_consumer *c) {
+    if (csi_ring_consumer_count(c) == 0) {
+        return NULL;
+    }
+    return csi_ring_consumer_slot(c, c->tail);
+}
+
+/** Consumer: hand slot returned by csi_ring_consume_begin() back */
+static inline void csi_ring_consume_end(struct csi_ring_consumer *c) {
+    c->tail = c->tail + 1 == 2 * c->slot_count ? 0 : c->tail + 1;
+    // release keeps our reads of the slot before the producer may reuse it
+    __atomic_store_n(&c->ctrl->tail, c->tail, __ATOMIC_RELEASE);
+}
+
+/**
+ * Consumer: announce that we are about to sleep on the doorbell. Returns
+ * non-zero if the ring is still empty and the caller may wait for the
+ * interrupt, zero if frames arrived in the meantime and it must not sleep.
+ * Call csi_ring_consumer_woken() once running again.
+ */
+static inline int csi_ring_consumer_arm(struct csi_ring_consumer *c) {
+    __atomic_store_n(&c->ctrl->consumer_waiting, 1, __ATOMIC_RELAXED);
+    // store-load barrier, pairs with the one in csi_ring_producer_should_ring()
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (csi_ring_consumer_count(c)) {
+        __atomic_store_n(&c->ctrl->consumer_waiting, 0, __ATOMIC_RELAXED);
+        return 0;
+    }
+    return 1;
+}
+
+static inline void csi_ring_consumer_woken(struct csi_ring_consumer *c) {
+    __atomic_store_n(&c->ctrl->consumer_waiting, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * Producer: call after csi_ring_produce_commit() (or a batch of them).
+ * Returns non-zero if the consumer is asleep and the doorbell has to be rung.
+ * Doorbells are only sent on this transition, so a streaming producer does not
+ * trap into the hypervisor per frame.
+ */
+static inline int csi_ring_producer_should_ring(struct csi_ring_ctrl *ring) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return __atomic_exchange_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * Consumer: switch between CSI_RING_MODE_STREAM and CSI_RING_MODE_WINDOW.
+ * Frames queued before switching back to stream mode are discarded, as the
+ * producer may have overwritten them.
+ */
+static inline void csi_ring_set_mode(struct csi_ring_consumer *c, uint32_t mode) {
+    if (mode == CSI_RING_MODE_STREAM) {
+        uint32_t head = csi_ring_consumer_head(c);
+
+        // an out of range head leaves tail alone, the ring stays empty
+        if (head < 2 * c->slot_count) {
+            c->tail = head;
+            __atomic_store_n(&c->ctrl->tail, head, __ATOMIC_RELEASE);
+        }
+    }
+    __atomic_store_n(&c->ctrl->mode, mode, __ATOMIC_RELEASE);
+}
+
+/**
+ * Consumer: copy up to 'max_frames' of the most recent frames, newest first,
+ * into 'out' (an array of CSI_RING_SLOT_SIZE byte records). Only frames captured no
+ * earlier than 'max_age_ns' before 'now_ns' and, if 'mac' is not NULL, sent
+ * by that transmitter are taken. Does not modify the ring, so it can be used
+ * in window mode while the producer keeps overwriting old slots. Returns the
+ * number of frames copied.
+ */
+static inline uint32_t csi_ring_read_recent(struct csi_ring_consumer *c,
+                                            uint64_t now_ns, uint64_t max_age_ns,
+                                            const uint8_t *mac, void *out,
+                                            uint32_t max_frames) {
+    uint32_t idx = csi_ring_consumer_head(c);
+    uint64_t oldest = now_ns > max_age_ns ? now_ns - max_age_ns : 0;
+    uint8_t *dst = out;
+    uint32_t copied = 0;
+
+    if (idx == 2 * c->slot_count) {
+        return 0;
+    }
+    // the slot at head may already be in the producer's hands, skip it
+    for (uint32_t i = 1; i < c->slot_count && copied < max_frames; ++i) {
+        struct csi_frame_hdr *frame, *copy = (struct csi_frame_hdr *)dst;
+        uint32_t lock;
+
+        idx = idx == 0 ? 2 * c->slot_count - 1 : idx - 1;
+        frame = csi_ring_consumer_slot(c, idx);
+        lock = __atomic_load_n(&frame->lock, __ATOMIC_ACQUIRE);
+        if (lock == 0 || (lock & 1)) {
+            break;  // never written or being overwritten, older ones are gone
+        }
+        __builtin_memcpy(copy, frame, sizeof(*frame));
+        if (copy->len > CSI_FRAME_MAX_PAYLOAD) {
+            break;
+        }
+        __builtin_memcpy(copy + 1, frame + 1, copy->len);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&frame->lock, __ATOMIC_RELAXED) != lock ||
+            copy->timestamp_ns < oldest) {
+            break;  // torn copy or too old, everything before is older still
+        }
+        if (mac != NULL && __builtin_memcmp(copy->mac, mac, sizeof(copy->mac))) {
+            continue;
+        }
+        dst += CSI_RING_SLOT_SIZE;
+        ++copied;
+    }
+    return copied;
+}
+
+/** Reference to a frame read in place, see csi_ring_ref_recent() */
+struct csi_frame_ref {
+    const struct csi_frame_hdr *frame;
+    uint32_t lock;          // slot lock seen when the reference was taken
+};
+
+/**
+ * Consumer: like csi_ring_read_recent() but without copying. Fills 'refs'
+ * with pointers into the (possibly read-only mapped) ring. The producer may
+ * overwrite a referenced slot at any time in window mode, so every frame must
+ * be checked with csi_frame_ref_valid() after its payload was used, and 'len'
+ * must be checked against CSI_FRAME_MAX_PAYLOAD before it is.
+ */
+static inline uint32_t csi_ring_ref_recent(struct csi_ring_consumer *c,
+                                           uint64_t now_ns, uint64_t max_age_ns,
+                                           const uint8_t *mac,
+                                           struct csi_frame_ref *refs,
+                                           uint32_t max_frames) {
+    uint32_t idx = csi_ring_consumer_head(c);
+    uint64_t oldest = now_ns > max_age_ns ? now_ns - max_age_ns : 0;
+    uint32_t found = 0;
+
+    if (idx == 2 * c->slot_count) {
+        return 0;
+    }
+    for (uint32_t i = 1; i < c->slot_count && found < max_frames; ++i) {
+        struct csi_frame_hdr *frame;
+        uint64_t timestamp;
+        uint32_t lock;
+        int mac_match;
+
+        idx = idx == 0 ? 2 * c->slot_count - 1 : idx - 1;
+        frame = csi_ring_consumer_slot(c, idx);
+        lock = __atomic_load_n(&frame->lock, __ATOMIC_ACQUIRE);
+        if (lock == 0 || (lock & 1)) {
+            break;
+        }
+        timestamp = frame->timestamp_ns;
+        mac_match = mac == NULL ||
+                    !__builtin_memcmp(frame->mac, mac, sizeof(frame->mac));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&frame->lock, __ATOMIC_RELAXED) != lock ||
+            timestamp < oldest) {
+            break;
+        }
+        if (mac_match) {
+            refs[found].frame = frame;
+            refs[found].lock = lock;
+            ++found;
+        }
+    }
+    return found;
+}
+
+/**
+ * Return non-zero if the frame behind 'ref' was not overwritten since the
+ * reference was taken, i.e. everything read from it so far is consistent.
+ */
+static inline int csi_frame_ref_valid(const struct csi_frame_ref *ref) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&ref->frame->lock, __ATOMIC_RELAXED) == ref->lock;
+}
+
+/*
+ * Batched collection: OP-TEE describes every device of a fingerprint in one
+ * request, the Nexmon VM captures all of them in a single window, tags each
+ * frame with batch_id/batch_entry and pushes them into the ring.
+ */
+#define CSI_BATCH_MAX_ENTRIES       16
+
+#define CSI_BATCH_STATUS_PENDING    0
+#define CSI_BATCH_STATUS_DONE       1   // every entry got its samples
+#define CSI_BATCH_STATUS_TIMEOUT    2   // see entries[].collected
+#define CSI_BATCH_STATUS_ERROR      3   // e.g. channel not supported
+
+struct csi_batch_entry {
+    uint8_t mac[6];         // transmitter to record
+    uint8_t channel;        // WiFi channel
+    uint8_t bandwidth;      // MHz: 20, 40 or 80
+    uint16_t samples;       // requested frames
+    uint16_t collected;     // written by the producer
+    uint32_t reserved;
+};
+
+_Static_assert(sizeof(struct csi_batch_entry) == 16,
+               "CSI batch entry layout changed");
+
+struct csi_batch_request {
+    uint32_t id;            // consumer: last submitted request, never 0
+    uint32_t completed_id;  // producer: last finished request
+    uint32_t status;        // producer: CSI_BATCH_STATUS_* of completed_id
+    uint32_t timeout_ms;
+    uint32_t entry_count;
+    uint32_t reserved[3];
+    struct csi_batch_entry entries[CSI_BATCH_MAX_ENTRIES];
+    // producer timestamps of completed_id (csi_clock_ns()), for latency
+    // breakdowns: request wait = started - submit, capture = completed - started
+    uint64_t started_ns;
+    uint64_t completed_ns;
+};
+
+_Static_assert(CSI_BATCH_OFFSET >= CSI_RING_CTRL_OFFSET + sizeof(struct csi_ring_ctrl) &&
+               CSI_BATCH_OFFSET + sizeof(struct csi_batch_request) <=
+               CSI_RING_CTRL_OFFSET + CSI_RING_DATA_OFFSET,
+               "CSI batch request overlaps the ring");
+
+/** Return batch request block inside the shared region starting at 'shm' */
+static inline struct csi_batch_request *csi_batch_from_shm(void *shm) {
+    return (struct csi_batch_request *)((uint8_t *)shm + CSI_BATCH_OFFSET);
+}
+
+/**
+ * Consumer: post a request for 'count' entries and return its id. The
+ * previous request must have completed. Ring the Nexmon doorbell afterwards.
+ */
+static inline uint32_t csi_batch_submit(struct csi_batch_request *batch,
+                                        const struct csi_batch_entry *entries,
+                                        uint32_t count, uint32_t timeout_ms) {
+    uint32_t id = batch->id + 1 ? batch->id + 1 : 1;
+
+    if (count > CSI_BATCH_MAX_ENTRIES) {
+        count = CSI_BATCH_MAX_ENTRIES;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        batch->entries[i] = entries[i];
+        batch->entries[i].collected = 0;
+    }
+    batch->entry_count = count;
+    batch->timeout_ms = timeout_ms;
+    // release publishes the descriptor together with the new id
+    __atomic_store_n(&batch->id, id, __ATOMIC_RELEASE);
+    return id;
+}
+
+/** Consumer: return CSI_BATCH_STATUS_* of request 'id' */
+static inline uint32_t csi_batch_status(struct csi_batch_request *batch,
+                                        uint32_t id) {
+    if (__atomic_load_n(&batch->completed_id, __ATOMIC_ACQUIRE) != id) {
+        return CSI_BATCH_STATUS_PENDING;
+    }
+    return batch->status;
+}
+
+/** Producer: return id of a request waiting to be captured or 0 */
+static inline uint32_t csi_batch_pending(struct csi_batch_request *batch) {
+    uint32_t id = __atomic_load_n(&batch->id, __ATOMIC_ACQUIRE);
+
+    return id != batch->completed_id ? id : 0;
+}
+
+/** Producer: note that capturing the pending request started at 'now_ns' */
+static inline void csi_batch_start(struct csi_batch_request *batch, uint64_t now_ns) {
+    batch->started_ns = now_ns;
+}
+
+/**
+ * Producer: finish the pending request at 'now_ns', then ring the OP-TEE
+ * doorbell
+ */
+static inline void csi_batch_complete(struct csi_batch_request *batch,
+                                      uint32_t id, uint32_t status,
+                                      uint64_t now_ns) {
+    batch->status = status;
+    batch->completed_ns = now_ns;
+    __atomic_store_n(&batch->completed_id, id, __ATOMIC_RELEASE);
+}
+
+#endif // CSI_RING_H
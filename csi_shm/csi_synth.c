@@ -0,0 +1,26 @@
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "csi_ring.h"
+#include "csi_synth.h"
+
+uint64_t csi_now_ns(void) {
+#if defined(__aarch64__)
+    return csi_clock_ns();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+void csi_synth_frame(int16_t *iq, size_t subcarriers, size_t i) {
+    for (size_t k = 0; k < subcarriers; ++k) {
+        double amp = 2000 + 800 * sin(k * 0.2) + rand() % 100;
+        double phase = 0.3 * k + 0.7 * i;
+        iq[2 * k] = amp * cos(phase);
+        iq[2 * k + 1] = amp * sin(phase);
+    }
+}
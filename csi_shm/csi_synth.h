@@ -0,0 +1,23 @@
+/*
+ * Helpers shared by the host-side csi_shm tools: the clock every tool stamps
+ * frames and measures with, and synthetic CSI for runs without a recording.
+ */
+#ifndef CSI_SYNTH_H
+#define CSI_SYNTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Return monotonic time in ns. On the Pi this is csi_clock_ns(), so frame
+ * timestamps can be compared against the clock in OP-TEE.
+ */
+uint64_t csi_now_ns(void);
+
+/**
+ * Fill 'iq' with 'subcarriers' I/Q pairs of synthetic frame 'i': a smooth
+ * amplitude profile with a little noise and a phase that rotates per frame.
+ */
+void csi_synth_frame(int16_t *iq, size_t subcarriers, size_t i);
+
+#endif // CSI_SYNTH_H
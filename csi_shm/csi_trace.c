@@ -0,0 +1,119 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "csi_trace.h"
+
+int csi_trace_open(struct csi_trace *trace, const char *path) {
+    const struct csi_trace_hdr *hdr;
+    struct stat st;
+    void *map;
+    int fd = open(path, O_RDONLY);
+    uint32_t fits;
+
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) || st.st_size < (off_t)sizeof(*hdr)) {
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    hdr = map;
+    if (hdr->magic != CSI_TRACE_MAGIC || hdr->version != CSI_TRACE_VERSION ||
+        hdr->header_size < sizeof(*hdr) || hdr->header_size > st.st_size ||
+        hdr->subcarriers == 0 || hdr->subcarriers > CSI_MAX_SUBCARRIERS ||
+        hdr->frame_size < csi_trace_frame_size(hdr->subcarriers) ||
+        hdr->frame_size % 8) {
+        munmap(map, st.st_size);
+        return -1;
+    }
+    fits = (st.st_size - hdr->header_size) / hdr->frame_size;
+
+    trace->hdr = hdr;
+    trace->frames = (const uint8_t *)map + hdr->header_size;
+    trace->frame_count = hdr->frame_count && hdr->frame_count <= fits ?
+                         hdr->frame_count : fits;
+    trace->map_size = st.st_size;
+    // playback only walks forward
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+void csi_trace_close(struct csi_trace *trace) {
+    munmap((void *)trace->hdr, trace->map_size);
+    trace->hdr = NULL;
+}
+
+int csi_trace_create(struct csi_trace_writer *writer, const char *path,
+                     uint16_t subcarriers, uint8_t channel, uint8_t bandwidth) {
+    if (subcarriers == 0 || subcarriers > CSI_MAX_SUBCARRIERS ||
+        (writer->file = fopen(path, "wb")) == NULL) {
+        return -1;
+    }
+    memset(&writer->hdr, 0, sizeof(writer->hdr));
+    writer->hdr.magic = CSI_TRACE_MAGIC;
+    writer->hdr.version = CSI_TRACE_VERSION;
+    writer->hdr.header_size = sizeof(writer->hdr);
+    writer->hdr.frame_size = csi_trace_frame_size(subcarriers);
+    writer->hdr.subcarriers = subcarriers;
+    writer->hdr.channel = channel;
+    writer->hdr.bandwidth = bandwidth;
+    // frame_count stays 0 until csi_trace_finish()
+    if (fwrite(&writer->hdr, sizeof(writer->hdr), 1, writer->file) != 1) {
+        fclose(writer->file);
+        return -1;
+    }
+    return 0;
+}
+
+int csi_trace_append(struct csi_trace_writer *writer, const struct csi_frame_hdr *frame) {
+    static const uint8_t zero[8];
+    size_t len = (size_t)writer->hdr.subcarriers * 2 * sizeof(int16_t);
+    size_t pad = writer->hdr.frame_size - sizeof(*frame) - len;
+    struct csi_frame_hdr copy = *frame;
+
+    if (frame->subcarriers != writer->hdr.subcarriers || frame->len < len) {
+        return -1;
+    }
+    if (writer->hdr.frame_count == 0) {
+        // store the start right away, a recorder that dies never finishes
+        writer->hdr.start_ns = frame->timestamp_ns;
+        if (fseek(writer->file, 0, SEEK_SET) ||
+            fwrite(&writer->hdr, sizeof(writer->hdr), 1, writer->file) != 1 ||
+            fseek(writer->file, 0, SEEK_END)) {
+            return -1;
+        }
+    }
+    // the slot lock means nothing outside the ring
+    copy.lock = 0;
+    copy.len = len;
+    if (fwrite(&copy, sizeof(copy), 1, writer->file) != 1 ||
+        fwrite(frame + 1, len, 1, writer->file) != 1 ||
+        (pad && fwrite(zero, pad, 1, writer->file) != 1)) {
+        return -1;
+    }
+    writer->hdr.frame_count++;
+    return 0;
+}
+
+int csi_trace_finish(struct csi_trace_writer *writer) {
+    int ret = 0;
+
+    if (fseek(writer->file, 0, SEEK_SET) ||
+        fwrite(&writer->hdr, sizeof(writer->hdr), 1, writer->file) != 1) {
+        ret = -1;
+    }
+    if (fclose(writer->file)) {
+        ret = -1;
+    }
+    writer->file = NULL;
+    return ret;
+}
@@ -0,0 +1,106 @@
+/*
+ * On-disk CSI traces for reproducible replays.
+ *
+ * A trace is a 64 byte header followed by 'frame_count' fixed-size frame
+ * records. Every record is a struct csi_frame_hdr followed by the I/Q payload
+ * of 'subcarriers' subcarriers and padded to 'frame_size' bytes, i.e. exactly
+ * what a ring slot holds. A trace mapped with csi_trace_open() can therefore
+ * be handed frame by frame to csi_ring_produce_*(), csi_features_add() or
+ * csi_wire_encode() without any parsing or copying. Everything is stored in
+ * the byte order of the recorder; all supported machines are little-endian.
+ *
+ * The writer stores 'start_ns' with the first frame and fills in 'frame_count'
+ * when the trace is closed. A trace whose recorder died leaves the count at 0
+ * and readers take it from the file size.
+ */
+#ifndef CSI_TRACE_H
+#define CSI_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "csi_ring.h"
+
+#define CSI_TRACE_MAGIC         0x54495343 // "CSIT"
+#define CSI_TRACE_VERSION       1
+
+struct csi_trace_hdr {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;   // first frame record, relative to the file start
+    uint32_t frame_size;    // bytes per frame record
+    uint32_t frame_count;
+    uint16_t subcarriers;
+    uint8_t channel;        // WiFi channel, 0 if unknown
+    uint8_t bandwidth;      // MHz, 0 if unknown
+    uint32_t reserved0;
+    uint64_t start_ns;      // timestamp of the first frame
+    uint8_t reserved[CSI_RING_CACHE_LINE - 32];
+};
+
+_Static_assert(sizeof(struct csi_trace_hdr) == CSI_RING_CACHE_LINE,
+               "CSI trace header layout changed");
+
+/** Read-only, memory mapped trace */
+struct csi_trace {
+    const struct csi_trace_hdr *hdr;
+    const uint8_t *frames;
+    uint32_t frame_count;
+    size_t map_size;
+};
+
+/** Trace being recorded */
+struct csi_trace_writer {
+    FILE *file;
+    struct csi_trace_hdr hdr;
+};
+
+/** Size of one frame record for 'subcarriers' subcarriers */
+static inline uint32_t csi_trace_frame_size(uint16_t subcarriers) {
+    size_t size = sizeof(struct csi_frame_hdr) + (size_t)subcarriers * 2 * sizeof(int16_t);
+
+    // keep the 64 bit timestamps of every record naturally aligned
+    return (size + 7) & ~(size_t)7;
+}
+
+/** Map trace 'path', returns 0 or -1 (with errno set if a system call failed) */
+int csi_trace_open(struct csi_trace *trace, const char *path);
+
+void csi_trace_close(struct csi_trace *trace);
+
+/** Return frame 'i' of an opened trace */
+static inline const struct csi_frame_hdr *csi_trace_frame(const struct csi_trace *trace,
+                                                          uint32_t i) {
+    return (const struct csi_frame_hdr *)(trace->frames +
+                                          (size_t)i * trace->hdr->frame_size);
+}
+
+/** Nanoseconds between the first frame and frame 'i', for paced playback */
+static inline uint64_t csi_trace_offset_ns(const struct csi_trace *trace, uint32_t i) {
+    uint64_t ts = csi_trace_frame(trace, i)->timestamp_ns;
+
+    return ts > trace->hdr->start_ns ? ts - trace->hdr->start_ns : 0;
+}
+
+/** Like csi_trace_offset_ns() for frame 'i' of the trace played in a loop */
+static inline uint64_t csi_trace_loop_offset_ns(const struct csi_trace *trace, uint64_t i) {
+    uint32_t n = trace->frame_count;
+    uint64_t last = csi_trace_offset_ns(trace, n - 1);
+    // the next pass starts one average frame gap after the last frame
+    uint64_t pass = last + (n > 1 ? last / (n - 1) : 0);
+
+    return (i / n) * pass + csi_trace_offset_ns(trace, i % n);
+}
+
+/** Start recording 'subcarriers' wide frames to 'path' */
+int csi_trace_create(struct csi_trace_writer *writer, const char *path,
+                     uint16_t subcarriers, uint8_t channel, uint8_t bandwidth);
+
+/** Append 'frame', returns -1 if its shape does not match the trace */
+int csi_trace_append(struct csi_trace_writer *writer, const struct csi_frame_hdr *frame);
+
+/** Write the final header and close the file */
+int csi_trace_finish(struct csi_trace_writer *writer);
+
+#endif // CSI_TRACE_H
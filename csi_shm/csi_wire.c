@@ -0,0 +1,259 @@
+#include <string.h>
+
+#include "csi_wire.h"
+
+// zigzag varint of a 17 bit delta never needs more than 3 bytes
+#define VARINT_MAX_BYTES 3
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v);
+    put_u16(p + 2, v >> 16);
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+    put_u32(p, v);
+    put_u32(p + 4, v >> 32);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return p[0] | (uint16_t)p[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | (uint32_t)get_u16(p + 2) << 16;
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    return get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+static size_t value_size(uint8_t flags) {
+    if (flags & CSI_WIRE_F_DELTA) {
+        return VARINT_MAX_BYTES;
+    }
+    return flags & CSI_WIRE_F_INT8 ? 1 : 2;
+}
+
+/** Smallest shift that brings every value of 'iq' into the quantized range */
+static uint8_t pick_shift(const int16_t *iq, size_t n, uint8_t flags) {
+    int32_t max = 0;
+    uint8_t shift = 0;
+
+    if (!(flags & CSI_WIRE_F_INT8)) {
+        return 0;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        int32_t v = iq[i] < 0 ? -(int32_t)iq[i] - 1 : iq[i];
+        if (v > max) {
+            max = v;
+        }
+    }
+    while ((max >> shift) > INT8_MAX) {
+        ++shift;
+    }
+    return shift;
+}
+
+static int16_t quantize(int16_t v, uint8_t shift, uint8_t flags) {
+    int32_t q = v;
+
+    if (shift) {
+        q = (q + (1 << (shift - 1))) >> shift;
+    }
+    if (flags & CSI_WIRE_F_INT8) {
+        q = q > INT8_MAX ? INT8_MAX : q < INT8_MIN ? INT8_MIN : q;
+    }
+    return q;
+}
+
+static size_t put_varint(uint8_t *p, int32_t v) {
+    uint32_t zz = ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+    size_t n = 0;
+
+    while (zz >= 0x80) {
+        p[n++] = zz | 0x80;
+        zz >>= 7;
+    }
+    p[n++] = zz;
+    return n;
+}
+
+static size_t get_varint(const uint8_t *p, size_t len, int32_t *v) {
+    uint32_t zz = 0;
+    size_t n = 0;
+
+    do {
+        if (n == len || n == VARINT_MAX_BYTES) {
+            return 0;
+        }
+        zz |= (uint32_t)(p[n] & 0x7f) << (7 * n);
+    } while (p[n++] & 0x80);
+    *v = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+    return n;
+}
+
+size_t csi_wire_bound(uint16_t subcarriers, uint16_t frame_count, uint8_t flags) {
+    return CSI_WIRE_HEADER_SIZE + (size_t)frame_count *
+           (CSI_WIRE_FRAME_HEADER_SIZE + (size_t)subcarriers * 2 * value_size(flags));
+}
+
+long csi_wire_encode(uint8_t *out, size_t out_size, uint8_t flags,
+                     const struct csi_frame_hdr *const *frames, uint16_t count) {
+    int16_t prev[CSI_MAX_SUBCARRIERS * 2] = { 0 };
+    uint16_t subcarriers = count ? frames[0]->subcarriers : 0;
+    size_t n_values = (size_t)subcarriers * 2;
+    uint64_t base = count ? frames[0]->timestamp_ns : 0;
+    uint8_t *p = out + CSI_WIRE_HEADER_SIZE;
+
+    if (subcarriers > CSI_MAX_SUBCARRIERS ||
+        out_size < csi_wire_bound(subcarriers, count, flags)) {
+        return -1;
+    }
+
+    for (uint16_t f = 0; f < count; ++f) {
+        const struct csi_frame_hdr *frame = frames[f];
+        const int16_t *iq = (const int16_t *)(frame + 1);
+        uint64_t delta_us = frame->timestamp_ns > base ?
+                            (frame->timestamp_ns - base) / 1000 : 0;
+        uint8_t *frame_start = p;
+        uint8_t shift;
+
+        if (frame->subcarriers != subcarriers ||
+            frame->len < n_values * sizeof(int16_t)) {
+            return -1;
+        }
+        shift = pick_shift(iq, n_values, flags);
+        frame_start[2] = shift;
+        frame_start[3] = (uint8_t)frame->rssi;
+        put_u32(frame_start + 4, delta_us > UINT32_MAX ? UINT32_MAX : delta_us);
+        p += CSI_WIRE_FRAME_HEADER_SIZE;
+
+        for (size_t i = 0; i < n_values; ++i) {
+            int16_t q = quantize(iq[i], shift, flags);
+
+            if (flags & CSI_WIRE_F_DELTA) {
+                p += put_varint(p, (int32_t)q - prev[i]);
+                prev[i] = q;
+            } else if (flags & CSI_WIRE_F_INT8) {
+                *p++ = (uint8_t)q;
+            } else {
+                put_u16(p, q);
+                p += 2;
+            }
+        }
+        put_u16(frame_start, p - frame_start - 2);
+    }
+
+    put_u32(out, CSI_WIRE_MAGIC);
+    out[4] = CSI_WIRE_VERSION;
+    out[5] = flags;
+    put_u16(out + 6, subcarriers);
+    put_u16(out + 8, count);
+    put_u16(out + 10, 0);
+    put_u64(out + 12, base);
+    put_u32(out + 20, p - out - CSI_WIRE_HEADER_SIZE);
+    return p - out;
+}
+
+int csi_wire_parse_header(const uint8_t *in, size_t len,
+                          struct csi_wire_info *info) {
+    if (len < CSI_WIRE_HEADER_SIZE || get_u32(in) != CSI_WIRE_MAGIC) {
+        return -1;
+    }
+    info->version = in[4];
+    info->flags = in[5];
+    info->subcarriers = get_u16(in + 6);
+    info->frame_count = get_u16(in + 8);
+    info->base_timestamp_ns = get_u64(in + 12);
+    info->payload_len = get_u32(in + 20);
+    if (info->version != CSI_WIRE_VERSION ||
+        info->subcarriers > CSI_MAX_SUBCARRIERS ||
+        info->payload_len > len - CSI_WIRE_HEADER_SIZE) {
+        return -1;
+    }
+    return 0;
+}
+
+int csi_wire_decode(const uint8_t *in, size_t len, struct csi_wire_info *info,
+                    int16_t *iq, uint64_t *timestamps_ns, int8_t *rssi) {
+    int16_t prev[CSI_MAX_SUBCARRIERS * 2] = { 0 };
+    const uint8_t *p, *end;
+    size_t n_values;
+    int32_t q_min, q_max;
+
+    if (csi_wire_parse_header(in, len, info)) {
+        return -1;
+    }
+    p = in + CSI_WIRE_HEADER_SIZE;
+    end = p + info->payload_len;
+    n_values = (size_t)info->subcarriers * 2;
+    q_min = info->flags & CSI_WIRE_F_INT8 ? INT8_MIN : INT16_MIN;
+    q_max = info->flags & CSI_WIRE_F_INT8 ? INT8_MAX : INT16_MAX;
+
+    for (uint16_t f = 0; f < info->frame_count; ++f) {
+        const uint8_t *frame_end;
+        uint8_t shift;
+
+        if (end - p < CSI_WIRE_FRAME_HEADER_SIZE) {
+            return -1;
+        }
+        frame_end = p + 2 + get_u16(p);
+        shift = p[2];
+        if (frame_end > end || shift > 15) {
+            return -1;
+        }
+        if (rssi) {
+            rssi[f] = (int8_t)p[3];
+        }
+        if (timestamps_ns) {
+            timestamps_ns[f] = info->base_timestamp_ns + (uint64_t)get_u32(p + 4) * 1000;
+        }
+        p += CSI_WIRE_FRAME_HEADER_SIZE;
+
+        for (size_t i = 0; i < n_values; ++i) {
+            int32_t q, v;
+
+            if (info->flags & CSI_WIRE_F_DELTA) {
+                int32_t delta;
+                size_t n = get_varint(p, frame_end - p, &delta);
+
+                if (n == 0) {
+                    return -1;
+                }
+                p += n;
+                // an untrusted delta may leave the range the encoder quantized to
+                q = prev[i] + delta;
+                if (q < q_min || q > q_max) {
+                    return -1;
+                }
+                prev[i] = q;
+            } else if (info->flags & CSI_WIRE_F_INT8) {
+                if (p == frame_end) {
+                    return -1;
+                }
+                q = (int8_t)*p++;
+            } else {
+                if (frame_end - p < 2) {
+                    return -1;
+                }
+                q = (int16_t)get_u16(p);
+                p += 2;
+            }
+            // |q| <= 2^15 and shift <= 15, so this cannot overflow int32
+            v = q * (1 << shift);
+            if (v < INT16_MIN || v > INT16_MAX) {
+                return -1;
+            }
+            *iq++ = v;
+        }
+        if (p != frame_end) {
+            return -1;
+        }
+    }
+    return 0;
+}
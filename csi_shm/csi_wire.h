@@ -0,0 +1,70 @@
+/*
+ * Compact binary wire format for CSI uploads.
+ *
+ * A message is a fixed header followed by 'frame_count' frames. Every value
+ * is little-endian. I/Q samples are quantized to int16 or int8 with a
+ * per-frame power-of-two scale (value = q << shift). With CSI_WIRE_F_DELTA
+ * every frame after the first stores the difference to the previous frame's
+ * quantized values as zigzag varints, which shrinks the mostly static CSI of a
+ * stationary device to about one byte per value.
+ *
+ *   header:  u32 magic, u8 version, u8 flags, u16 subcarriers,
+ *            u16 frame_count, u16 reserved, u64 base_timestamp_ns,
+ *            u32 payload_len
+ *   frame:   u16 frame_len, u8 shift, s8 rssi, u32 timestamp_delta_us,
+ *            values (frame_len counts everything after itself)
+ *
+ * Like csi_ring.h this only needs the compiler and memcpy(), so it builds in
+ * the TA as well as in host tools.
+ */
+#ifndef CSI_WIRE_H
+#define CSI_WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "csi_ring.h"
+
+#define CSI_WIRE_MAGIC              0x57495343 // "CSIW"
+#define CSI_WIRE_VERSION            1
+
+#define CSI_WIRE_F_INT8             (1 << 0) // int8 values instead of int16
+#define CSI_WIRE_F_DELTA            (1 << 1) // zigzag varint inter-frame deltas
+
+#define CSI_WIRE_HEADER_SIZE        24
+#define CSI_WIRE_FRAME_HEADER_SIZE  8
+
+/** Message header as decoded by csi_wire_parse_header() */
+struct csi_wire_info {
+    uint8_t version;
+    uint8_t flags;
+    uint16_t subcarriers;
+    uint16_t frame_count;
+    uint64_t base_timestamp_ns;
+    uint32_t payload_len;
+};
+
+/** Upper bound of an encoded message for the given shape */
+size_t csi_wire_bound(uint16_t subcarriers, uint16_t frame_count, uint8_t flags);
+
+/**
+ * Encode 'count' ring frames into 'out'. All frames must have the same number
+ * of subcarriers. Returns encoded length or -1 if the frames are inconsistent
+ * or 'out_size' is too small.
+ */
+long csi_wire_encode(uint8_t *out, size_t out_size, uint8_t flags,
+                     const struct csi_frame_hdr *const *frames, uint16_t count);
+
+/** Parse message header, returns 0 or -1 if 'in' is not a valid message */
+int csi_wire_parse_header(const uint8_t *in, size_t len,
+                          struct csi_wire_info *info);
+
+/**
+ * Decode a whole message. 'iq' receives frame_count * subcarriers * 2 values,
+ * 'timestamps_ns' and 'rssi' (both optional) one entry per frame. Returns 0
+ * or -1 on malformed input.
+ */
+int csi_wire_decode(const uint8_t *in, size_t len, struct csi_wire_info *info,
+                    int16_t *iq, uint64_t *timestamps_ns, int8_t *rssi);
+
+#endif // CSI_WIRE_H
@@ -0,0 +1,346 @@
+// Stand-in for the remote service side of the CSI wire format: decodes an
+// upload produced by csi_wire_encode() and prints it. Can also produce such
+// uploads from a CSI trace (e.g. recorded with csi_producer -o) and check that
+// every flag combination survives the round trip.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "csi_trace.h"
+#include "csi_wire.h"
+
+#define WIRE_MAX_FRAMES 65535
+
+struct Params {
+    int csv;                    // print every value as CSV
+    int encode;                 // encode a trace instead of decoding
+    int roundtrip;              // check a trace in all flag combinations
+    uint8_t flags;              // CSI_WIRE_F_* used for encoding
+    const char *in;
+    const char *out;
+} params;
+
+/** Parse params and save them to 'params' global struct */
+int parse_params(int argc, char **argv);
+/** Read whole file 'path' ("-" for stdin) into a malloc'ed buffer */
+static uint8_t *read_file(const char *path, size_t *len);
+/** Decode params.in and print it */
+int decode(void);
+/**
+ * Encode up to WIRE_MAX_FRAMES frames of 'trace' with 'flags' into a malloc'ed
+ * message, returns it or NULL
+ */
+uint8_t *encode_trace(const struct csi_trace *trace, uint8_t flags, size_t *len);
+/** Encode params.in into params.out */
+int encode(void);
+/** Encode and decode params.in with every flag combination and compare */
+int roundtrip(void);
+
+int main(int argc, char **argv) {
+    if (parse_params(argc, argv)) {
+        return 1;
+    }
+    if (params.encode) {
+        return encode() ? 1 : 0;
+    }
+    if (params.roundtrip) {
+        return roundtrip() ? 1 : 0;
+    }
+    return decode() ? 1 : 0;
+}
+
+int parse_params(int argc, char **argv) {
+    char usage_str[] = "%s [-c] <file|->\n"
+                       "%s -e [-8] [-d] <trace> <file|->\n"
+                       "%s -r <trace>\n"
+                       "  -c  print every value as CSV instead of a summary\n"
+                       "  -e  encode a CSI trace into an upload\n"
+                       "  -8  with -e, int8 values (CSI_WIRE_F_INT8)\n"
+                       "  -d  with -e, inter-frame deltas (CSI_WIRE_F_DELTA)\n"
+                       "  -r  encode and decode a CSI trace in every flag combination\n";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "ce8dr")) != -1) {
+        switch (opt) {
+            case 'c':
+                params.csv = 1;
+                break;
+            case 'e':
+                params.encode = 1;
+                break;
+            case '8':
+                params.flags |= CSI_WIRE_F_INT8;
+                break;
+            case 'd':
+                params.flags |= CSI_WIRE_F_DELTA;
+                break;
+            case 'r':
+                params.roundtrip = 1;
+                break;
+            default:
+                fprintf(stderr, usage_str, argv[0], argv[0], argv[0]);
+                return -1;
+        }
+    }
+    if (params.encode + params.roundtrip + params.csv > 1 ||
+        (params.flags && !params.encode) ||
+        argc - optind != (params.encode ? 2 : 1)) {
+        fprintf(stderr, usage_str, argv[0], argv[0], argv[0]);
+        return -1;
+    }
+    params.in = argv[optind];
+    params.out = params.encode ? argv[optind + 1] : NULL;
+    return 0;
+}
+
+int decode(void) {
+    struct csi_wire_info info;
+    int16_t *iq = NULL;
+    uint64_t *timestamps = NULL;
+    int8_t *rssi = NULL;
+    size_t len;
+    int ret = -1;
+
+    uint8_t *msg = read_file(params.in, &len);
+    if (msg == NULL) {
+        return -1;
+    }
+    if (csi_wire_parse_header(msg, len, &info)) {
+        fprintf(stderr, "Not a CSI wire message\n");
+        goto out;
+    }
+
+    size_t n_values = (size_t)info.frame_count * info.subcarriers * 2;
+    iq = malloc(n_values * sizeof(*iq) + 1);
+    timestamps = malloc(info.frame_count * sizeof(*timestamps) + 1);
+    rssi = malloc(info.frame_count + 1);
+    if (iq == NULL || timestamps == NULL || rssi == NULL) {
+        fprintf(stderr, "Cannot allocate %u frames\n", info.frame_count);
+        goto out;
+    }
+    if (csi_wire_decode(msg, len, &info, iq, timestamps, rssi)) {
+        fprintf(stderr, "Malformed CSI wire message\n");
+        goto out;
+    }
+
+    if (params.csv) {
+        printf("frame,timestamp_ns,rssi,subcarrier,i,q\n");
+        for (size_t f = 0; f < info.frame_count; ++f) {
+            for (size_t s = 0; s < info.subcarriers; ++s) {
+                const int16_t *v = &iq[(f * info.subcarriers + s) * 2];
+                printf("%zu,%llu,%d,%zu,%d,%d\n", f,
+                       (unsigned long long)timestamps[f], rssi[f], s, v[0], v[1]);
+            }
+        }
+    } else {
+        size_t raw = n_values * sizeof(int16_t);
+        printf("version:     %u\n", info.version);
+        printf("flags:       %s%s\n", info.flags & CSI_WIRE_F_INT8 ? "int8" : "int16",
+               info.flags & CSI_WIRE_F_DELTA ? " delta" : "");
+        printf("subcarriers: %u\n", info.subcarriers);
+        printf("frames:      %u\n", info.frame_count);
+        printf("size:        %zu bytes (raw I/Q %zu bytes, %.1f%%)\n", len, raw,
+               raw ? 100.0 * len / raw : 0.0);
+    }
+    ret = 0;
+
+out:
+    free(rssi);
+    free(timestamps);
+    free(iq);
+    free(msg);
+    return ret;
+}
+
+uint8_t *encode_trace(const struct csi_trace *trace, uint8_t flags, size_t *len) {
+    uint16_t count = trace->frame_count > WIRE_MAX_FRAMES ? WIRE_MAX_FRAMES : trace->frame_count;
+    size_t bound = csi_wire_bound(trace->hdr->subcarriers, count, flags);
+    const struct csi_frame_hdr **frames = malloc(count * sizeof(*frames) + 1);
+    uint8_t *msg = malloc(bound);
+    long n;
+
+    if (frames == NULL || msg == NULL) {
+        fprintf(stderr, "Cannot allocate %zu bytes for the message\n", bound);
+        free(frames);
+        free(msg);
+        return NULL;
+    }
+    for (uint16_t i = 0; i < count; ++i) {
+        frames[i] = csi_trace_frame(trace, i);
+    }
+    n = csi_wire_encode(msg, bound, flags, frames, count);
+    free(frames);
+    if (n < 0) {
+        fprintf(stderr, "Trace frames do not fit the wire format\n");
+        free(msg);
+        return NULL;
+    }
+    *len = n;
+    return msg;
+}
+
+int encode(void) {
+    struct csi_trace trace;
+    FILE *f;
+    size_t len;
+    uint8_t *msg;
+    int ret = 0;
+
+    if (csi_trace_open(&trace, params.in) || trace.frame_count == 0) {
+        fprintf(stderr, "%s: not a CSI trace or empty\n", params.in);
+        return -1;
+    }
+    if (trace.frame_count > WIRE_MAX_FRAMES) {
+        fprintf(stderr, "Only the first %d of %u frames fit into one message\n",
+                WIRE_MAX_FRAMES, trace.frame_count);
+    }
+    msg = encode_trace(&trace, params.flags, &len);
+    csi_trace_close(&trace);
+    if (msg == NULL) {
+        return -1;
+    }
+
+    f = strcmp(params.out, "-") == 0 ? stdout : fopen(params.out, "wb");
+    if (f == NULL || fwrite(msg, len, 1, f) != 1 ||
+        (f != stdout && fclose(f))) {
+        perror(params.out);
+        ret = -1;
+    }
+    free(msg);
+    return ret;
+}
+
+/**
+ * Largest allowed difference between original and decoded values of 'frame'.
+ * int16 is lossless, int8 loses at most one quantization step, which is the
+ * smallest power of two that brings every value into int8 range.
+ */
+static int32_t tolerance(const struct csi_frame_hdr *frame, size_t n_values, uint8_t flags) {
+    const int16_t *iq = (const int16_t *)(frame + 1);
+    int32_t max = 0, step = 1;
+
+    if (!(flags & CSI_WIRE_F_INT8)) {
+        return 0;
+    }
+    for (size_t i = 0; i < n_values; ++i) {
+        int32_t v = iq[i] < 0 ? -(int32_t)iq[i] - 1 : iq[i];
+        if (v > max) {
+            max = v;
+        }
+    }
+    while (max / step > INT8_MAX) {
+        step *= 2;
+    }
+    return step;
+}
+
+int roundtrip(void) {
+    static const uint8_t combinations[] = {
+        0, CSI_WIRE_F_INT8, CSI_WIRE_F_DELTA, CSI_WIRE_F_INT8 | CSI_WIRE_F_DELTA,
+    };
+    struct csi_trace trace;
+    int ret = 0;
+
+    if (csi_trace_open(&trace, params.in) || trace.frame_count == 0) {
+        fprintf(stderr, "%s: not a CSI trace or empty\n", params.in);
+        return -1;
+    }
+    uint16_t count = trace.frame_count > WIRE_MAX_FRAMES ? WIRE_MAX_FRAMES : trace.frame_count;
+    size_t n_values = (size_t)trace.hdr->subcarriers * 2;
+    int16_t *iq = malloc(count * n_values * sizeof(*iq));
+    uint64_t *timestamps = malloc(count * sizeof(*timestamps));
+    int8_t *rssi = malloc(count);
+
+    if (iq == NULL || timestamps == NULL || rssi == NULL) {
+        fprintf(stderr, "Cannot allocate %u frames\n", count);
+        ret = -1;
+        goto out;
+    }
+    for (size_t c = 0; c < sizeof(combinations); ++c) {
+        uint8_t flags = combinations[c];
+        struct csi_wire_info info;
+        uint64_t base = csi_trace_frame(&trace, 0)->timestamp_ns;
+        size_t len, errors = 0;
+        uint8_t *msg = encode_trace(&trace, flags, &len);
+
+        if (msg == NULL) {
+            ret = -1;
+            goto out;
+        }
+        if (csi_wire_decode(msg, len, &info, iq, timestamps, rssi) ||
+            info.frame_count != count || info.subcarriers != trace.hdr->subcarriers) {
+            errors = count;
+        }
+        for (uint16_t f = 0; f < count && errors == 0; ++f) {
+            const struct csi_frame_hdr *frame = csi_trace_frame(&trace, f);
+            const int16_t *orig = (const int16_t *)(frame + 1);
+            const int16_t *dec = iq + f * n_values;
+            int32_t tol = tolerance(frame, n_values, flags);
+            // timestamps travel as whole microseconds after the first frame
+            uint64_t want_ts = frame->timestamp_ns > base ?
+                               base + (frame->timestamp_ns - base) / 1000 * 1000 : base;
+            int bad = rssi[f] != frame->rssi || timestamps[f] != want_ts;
+
+            for (size_t i = 0; i < n_values && !bad; ++i) {
+                int32_t diff = (int32_t)dec[i] - orig[i];
+
+                bad = diff > tol || -diff > tol;
+            }
+            errors += bad;
+        }
+        printf("%-11s %8zu bytes %6.1f%% of raw I/Q  %s\n",
+               flags == 0 ? "int16" : flags == CSI_WIRE_F_INT8 ? "int8" :
+               flags == CSI_WIRE_F_DELTA ? "int16 delta" : "int8 delta",
+               len, 100.0 * len / (count * n_values * sizeof(int16_t)),
+               errors ? "MISMATCH" : "ok");
+        if (errors) {
+            fprintf(stderr, "%zu of %u frames differ after decoding\n", errors, count);
+            ret = -1;
+        }
+        free(msg);
+    }
+
+out:
+    free(rssi);
+    free(timestamps);
+    free(iq);
+    csi_trace_close(&trace);
+    return ret;
+}
+
+static uint8_t *read_file(const char *path, size_t *len) {
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    size_t cap = 4096;
+    uint8_t *buf = malloc(cap);
+    size_t n;
+
+    if (f == NULL || buf == NULL) {
+        perror(path);
+        free(buf);
+        if (f != NULL && f != stdin) {
+            fclose(f);
+        }
+        return NULL;
+    }
+    *len = 0;
+    while ((n = fread(buf + *len, 1, cap - *len, f)) > 0) {
+        *len += n;
+        if (*len == cap) {
+            uint8_t *grown = realloc(buf, cap * 2);
+
+            if (grown == NULL) {
+                fprintf(stderr, "%s: cannot allocate %zu bytes\n", path, cap * 2);
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    if (f != stdin) {
+        fclose(f);
+    }
+    return buf;
+}
@@ -17,6 +17,9 @@ STEP_RANGE=""
 
 BUILDROOT_CONF_PATH="support/br-aarch64.config"
 LINUX_CONF_PATH="support/linux-aarch64.config"
+# >1 needs a hypervisor config giving OP-TEE as many CPUs, see
+# rpi4-ws/configs/rpi4-single-vTEE-dual-linux-mt
+OPTEE_THREADS=1
 
 print_usage() {
     echo "Available steps:"
@@ -30,6 +33,8 @@ print_usage() {
     echo "  $0 --all - execute all steps."
     echo "  $0 --steps=X-Y - execute steps from X to Y (inclusive)."
     echo "  [--buildroot_conf=PATH] [--linux_conf=PATH] - if not provided, defaults will be used."
+    echo "  [--optee_threads=N] - number of OP-TEE threads (default: 1)."
+    echo "  [--async_notif] - OP-TEE asynchronous notifications, not available yet (see env/README.md)."
     exit 1
 }
 
@@ -118,7 +123,7 @@ step_1() {
         CFG_SHMEM_START=$SHMEM_START \
         CFG_SHMEM_SIZE=$SHMEM_SIZE \
         CFG_CORE_DYN_SHM=n \
-        CFG_NUM_THREADS=1 \
+        CFG_NUM_THREADS=$OPTEE_THREADS \
         CFG_CORE_RESERVED_SHM=y \
         CFG_CORE_ASYNC_NOTIF=n \
         CFG_TZDRAM_SIZE=$TZDRAM_SIZE \
@@ -362,6 +367,21 @@ for arg in "$@"; do
     --linux_conf=*)
         LINUX_CONF_PATH="${arg#*=}"
         ;;
+    --optee_threads=*)
+        OPTEE_THREADS="${arg#*=}"
+        if ! [[ "$OPTEE_THREADS" =~ ^[1-9][0-9]*$ ]]; then
+            echo "Invalid number of OP-TEE threads: $OPTEE_THREADS"
+            print_usage
+        fi
+        ;;
+    --async_notif)
+        # advertising the capability without delivering the interrupt would
+        # leave every bottom half waiting forever
+        echo "--async_notif: the optee_os submodule cannot raise the notification"
+        echo "interrupt through the CROSSCON IPC hypercall yet, see"
+        echo "\"Asynchronous notifications\" in env/README.md."
+        exit 1
+        ;;
     *)
         echo "Unknown argument: $arg"
         print_usage
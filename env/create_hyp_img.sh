@@ -4,6 +4,8 @@ IMAGE=crosscon-demo-img.img
 MOUNT_DIR=/media/root/boot
 ROOT=$(git -C "$(dirname "$(realpath $0)")" rev-parse --show-toplevel)
 CONFIG_REPO="$ROOT/rpi4-ws/configs"
+# e.g. rpi4-single-vTEE-dual-linux-mt for an OP-TEE built with several threads
+HYP_CONFIG="${HYP_CONFIG:-rpi4-single-vTEE-dual-linux}"
 C_PATH="/work/gcc-arm-11.2-2022.02-x86_64-aarch64-none-elf/bin:/work/gcc-arm-11.2-2022.02-x86_64-aarch64-none-linux-gnu/bin:$PATH"
 
 # Function to clean up if script fails
@@ -60,7 +62,7 @@ sudo -u "$SUDO_USER" env PATH=$C_PATH make -C CROSSCON-Hypervisor/ \
     PLATFORM=rpi4 \
     CONFIG_BUILTIN=y \
     CONFIG_REPO=$CONFIG_REPO \
-    CONFIG=rpi4-single-vTEE-dual-linux \
+    CONFIG=$HYP_CONFIG \
     OPTIMIZATIONS=0 \
     SDEES='sdSGX sdTZ' \
     CROSS_COMPILE=aarch64-none-elf- \
@@ -72,7 +74,7 @@ sudo -u "$SUDO_USER" env PATH=$C_PATH make -C CROSSCON-Hypervisor/ \
     PLATFORM=rpi4 \
     CONFIG_BUILTIN=y \
     CONFIG_REPO=$CONFIG_REPO \
-    CONFIG=rpi4-single-vTEE-dual-linux \
+    CONFIG=$HYP_CONFIG \
     OPTIMIZATIONS=0 \
     SDEES="sdSGX sdTZ" \
     CROSS_COMPILE=aarch64-none-elf- \
@@ -85,7 +87,7 @@ cp -v rpi4-ws/bin/bl31.bin $MOUNT_DIR
 cp -v rpi4-ws/bin/u-boot.bin $MOUNT_DIR
 cp -v lloader/linux-rpi4.bin $MOUNT_DIR
 cp -vr rpi4-ws/firmware/boot/start* $MOUNT_DIR
-cp -uv CROSSCON-Hypervisor/bin/rpi4/builtin-configs/rpi4-single-vTEE-dual-linux/crossconhyp.bin $MOUNT_DIR
+cp -uv CROSSCON-Hypervisor/bin/rpi4/builtin-configs/$HYP_CONFIG/crossconhyp.bin $MOUNT_DIR
 
 echo "# Unmounting the image"
 umount $MOUNT_DIR
@@ -0,0 +1,20 @@
+/* Notes
+Variant of rpi4-single-vTEE-dual-linux for an OP-TEE built with several
+threads (env/build_rpi4.sh --optee_threads=N), so that one slow TA session
+(e.g. a TLS handshake in the CBA TA) no longer blocks every other client.
+Everything but the CPU assignment comes from the base configuration.
+CPU CORE ASSIGNMENT: 1,2,1 (host/optee_os/nexmon) -> bitmap 0x8, 0x6, 0x1
+OP-TEE's second core is taken from the Nexmon VM: the CSI is extracted by
+the WiFi firmware, the VM only forwards it. The host VM keeps its single core
+as the CBA clients run there. The device tree inside nexmon.bin still lists
+two CPUs; the hypervisor refuses PSCI CPU_ON for the missing one, so Linux
+should report that CPU 1 failed to come online and continue on CPU 0. This
+has not been checked on a board; when rebuilding nexmon.bin for this layout,
+drop the second CPU from its device tree.
+*/
+#define NEXMON_CPU_AFFINITY 0x1
+#define NEXMON_CPU_NUM      1
+#define OPTEE_CPU_AFFINITY  0x6
+#define OPTEE_CPU_NUM       2
+
+#include "../rpi4-single-vTEE-dual-linux/config.c"
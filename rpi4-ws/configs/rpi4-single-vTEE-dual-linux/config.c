@@ -15,6 +15,16 @@ Memory layout:
 - OPTEE_OS is from 0x10100000 -> 0x11100000
 */
 
+// CPU assignment, rpi4-single-vTEE-dual-linux-mt overrides it
+#ifndef NEXMON_CPU_AFFINITY
+#define NEXMON_CPU_AFFINITY 0x3
+#define NEXMON_CPU_NUM      2
+#endif
+#ifndef OPTEE_CPU_AFFINITY
+#define OPTEE_CPU_AFFINITY  0x4
+#define OPTEE_CPU_NUM       1
+#endif
+
 
 // Linux VM configuration
 struct vm_config host_linux = {
@@ -45,6 +55,8 @@ struct vm_config host_linux = {
                 .base = 0x08000000,
                 .size = 0x00200000,
                 .shmem_id = 0,
+                .interrupt_num = 1, // OP-TEE async notification (dts: optee interrupts = <0 0x17 1>)
+                .interrupts = (irqid_t[]) { 0x17 + 32 },
             },
             {
                 .base = 0x09000000,
@@ -109,12 +121,12 @@ struct vm_config nexmon_linux = {
         .size = VM_IMAGE_SIZE(nexmon_image),
     },
     .entry = 0x20200000,
-    .cpu_affinity = 0x3,
+    .cpu_affinity = NEXMON_CPU_AFFINITY,
 
     .type = 0,
 
     .platform = {
-        .cpu_num = 2,
+        .cpu_num = NEXMON_CPU_NUM,
         .region_num = 1,
         .regions =  (struct mem_region[]) {
             {
@@ -130,6 +142,8 @@ struct vm_config nexmon_linux = {
                 .base = 0x09000000,
                 .size = 0x00800000,
                 .shmem_id = 1,
+                .interrupt_num = 1, // CSI doorbell from OP-TEE (dts: interrupts = <0 0x14 1>)
+                .interrupts = (irqid_t[]) { 0x14 + 32 },
             },
         },
 	.dev_num = 4,
@@ -177,7 +191,7 @@ struct vm_config optee_os = {
         .size = VM_IMAGE_SIZE(optee_os_image),
     },
     .entry = 0x10100000,
-    .cpu_affinity = 0x4,
+    .cpu_affinity = OPTEE_CPU_AFFINITY,
 
 
     .type = 1,
@@ -186,7 +200,7 @@ struct vm_config optee_os = {
     .children = (struct vm_config*[]) { &host_linux, },
 
     .platform = {
-        .cpu_num = 1,
+        .cpu_num = OPTEE_CPU_NUM,
         .region_num = 1,
         .regions = (struct mem_region[]) {
             {
@@ -207,6 +221,8 @@ struct vm_config optee_os = {
                 .base = 0x09000000,
                 .size = 0x00800000,
                 .shmem_id = 1,
+                .interrupt_num = 1, // CSI doorbell from Nexmon, see csi_shm/README.md
+                .interrupts = (irqid_t[]) { 0x16 + 32 },
             }
         },
         .dev_num = 0,
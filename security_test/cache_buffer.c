@@ -0,0 +1,184 @@
+// set in Makefile
+#include DEVICE_CONFIGURATION
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "cache_buffer.h"
+
+// used if the kernel doesn't say
+#define DEFAULT_HUGE_PAGE_SIZE (2*1024*1024)
+
+static const char *kind_names[] = {
+    [BUFFER_MALLOC] = "malloc",
+    [BUFFER_THP] = "thp",
+    [BUFFER_HUGETLB] = "hugetlb",
+};
+
+/** Read the number following 'key' in 'path', in bytes, 0 if there is none */
+static size_t read_size(const char *path, const char *key) {
+    FILE *f = fopen(path, "r");
+    char line[128];
+    size_t size = 0;
+
+    if (f == NULL) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key, strlen(key)) == 0) {
+            char *end;
+
+            size = strtoul(line + strlen(key), &end, 10);
+            // /proc/meminfo counts in kB
+            if (strstr(end, "kB")) {
+                size *= 1024;
+            }
+            break;
+        }
+    }
+    fclose(f);
+    return size;
+}
+
+static size_t huge_page_size(enum buffer_kind kind) {
+    size_t size = kind == BUFFER_THP ?
+        read_size("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "") :
+        read_size("/proc/meminfo", "Hugepagesize:");
+
+    return size ? size : DEFAULT_HUGE_PAGE_SIZE;
+}
+
+int cache_buffer_kind(const char *name, enum buffer_kind *kind) {
+    for (size_t i = 0; i < sizeof(kind_names) / sizeof(*kind_names); ++i) {
+        if (strcmp(name, kind_names[i]) == 0) {
+            *kind = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *cache_buffer_kind_name(enum buffer_kind kind) {
+    return kind_names[kind];
+}
+
+int cache_buffer_alloc(struct cache_buffer *buf, size_t size, enum buffer_kind kind) {
+    size_t huge = huge_page_size(kind);
+
+    memset(buf, 0, sizeof(*buf));
+    buf->size = size;
+    buf->kind = kind;
+    switch (kind) {
+        case BUFFER_MALLOC:
+            buf->map = malloc(size);
+            if (buf->map == NULL) {
+                fprintf(stderr, "Cannot allocate %zu bytes\n", size);
+                return -1;
+            }
+            buf->addr = buf->map;
+            break;
+        case BUFFER_THP:
+            // one spare huge page to align the start to a huge page boundary,
+            // otherwise the kernel can only use small pages at both ends
+            buf->map_size = (size + huge - 1) / huge * huge + huge;
+            buf->map = mmap(NULL, buf->map_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (buf->map == MAP_FAILED) {
+                perror("mmap");
+                return -1;
+            }
+            buf->addr = (uint8_t *)(((uintptr_t)buf->map + huge - 1) & ~(uintptr_t)(huge - 1));
+            if (madvise(buf->addr, buf->map_size - huge, MADV_HUGEPAGE)) {
+                perror("madvise(MADV_HUGEPAGE), transparent huge pages disabled?");
+                munmap(buf->map, buf->map_size);
+                return -1;
+            }
+            break;
+        case BUFFER_HUGETLB:
+            buf->map_size = (size + huge - 1) / huge * huge;
+            buf->map = mmap(NULL, buf->map_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (buf->map == MAP_FAILED) {
+                fprintf(stderr, "Cannot map %zu bytes of huge pages, reserve them with "
+                                "'echo %zu > /proc/sys/vm/nr_hugepages'\n",
+                        buf->map_size, buf->map_size / huge);
+                return -1;
+            }
+            buf->addr = buf->map;
+            break;
+    }
+    // fault everything in now, evicting shouldn't measure page faults
+    memset(buf->addr, 1, size);
+
+    return 0;
+}
+
+void cache_buffer_free(struct cache_buffer *buf) {
+    if (buf->kind == BUFFER_MALLOC) {
+        free(buf->map);
+    }
+    else if (buf->map) {
+        munmap(buf->map, buf->map_size);
+    }
+    buf->map = NULL;
+}
+
+int cache_buffer_coverage(const struct cache_buffer *buf, libflush_session_t *session,
+                          struct cache_coverage *cov) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t sets_per_color = page / LINE_LENGTH;
+    size_t ways = (LLC_SIZE) / (NUMBER_OF_SETS * LINE_LENGTH);
+    size_t *lines = calloc(NUMBER_OF_SETS, sizeof(*lines));
+    uintptr_t first = (uintptr_t)buf->addr & ~(uintptr_t)(page - 1);
+    uintptr_t end = (uintptr_t)buf->addr + buf->size;
+    uintptr_t prev_pa = 0;
+
+    if (lines == NULL) {
+        return -1;
+    }
+    if (sets_per_color > NUMBER_OF_SETS) {
+        sets_per_color = NUMBER_OF_SETS;
+    }
+    memset(cov, 0, sizeof(*cov));
+    cov->total_colors = NUMBER_OF_SETS / sets_per_color;
+
+    for (uintptr_t va = first; va < end; va += page) {
+        uintptr_t pa = libflush_get_physical_address(session, va);
+
+        if (pa == 0) {
+            free(lines);
+            return -1;
+        }
+        if (va == first || pa != prev_pa + page) {
+            cov->runs++;
+        }
+        prev_pa = pa;
+        for (uintptr_t line = va; line < va + page && line < end; line += LINE_LENGTH) {
+            if (line < (uintptr_t)buf->addr) {
+                continue;
+            }
+            lines[((pa + line - va) / LINE_LENGTH) % NUMBER_OF_SETS]++;
+        }
+    }
+
+    cov->min_lines = SIZE_MAX;
+    for (size_t color = 0; color < cov->total_colors; ++color) {
+        size_t used = 0;
+
+        for (size_t set = color * sets_per_color; set < (color + 1) * sets_per_color; ++set) {
+            used |= lines[set];
+            cov->short_sets += lines[set] < ways;
+            if (lines[set] < cov->min_lines) {
+                cov->min_lines = lines[set];
+            }
+            if (lines[set] > cov->max_lines) {
+                cov->max_lines = lines[set];
+            }
+        }
+        cov->colors += used != 0;
+    }
+    free(lines);
+    return 0;
+}
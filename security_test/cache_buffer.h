@@ -0,0 +1,64 @@
+/*
+ * Eviction buffers with a known physical layout.
+ *
+ * Which cache sets a buffer covers depends on the physical frames behind it.
+ * malloc() hands out whatever 4 KiB frames the kernel has, so an LLC_SIZE
+ * buffer usually covers some sets more than 'ways' times and misses others.
+ * A buffer backed by huge pages (hugetlbfs or transparent huge pages) is
+ * physically contiguous over at least 2 MiB and covers every set exactly
+ * size / (NUMBER_OF_SETS * LINE_LENGTH) times, which also needs far fewer TLB
+ * entries while evicting.
+ *
+ * Coverage is checked from physical addresses read through /proc/self/pagemap
+ * (libflush built with HAVE_PAGEMAP_ACCESS=1, run as root). Those are the
+ * addresses as the VM sees them, the hypervisor may still recolor them.
+ */
+#ifndef CACHE_BUFFER_H
+#define CACHE_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libflush/libflush.h>
+
+enum buffer_kind {
+    BUFFER_MALLOC,  // plain malloc()
+    BUFFER_THP,     // anonymous mapping aligned to and advised for THP
+    BUFFER_HUGETLB, // MAP_HUGETLB, needs reserved huge pages
+};
+
+struct cache_buffer {
+    uint8_t *addr;          // first usable byte
+    size_t size;
+    void *map;              // what has to be released
+    size_t map_size;
+    enum buffer_kind kind;
+};
+
+struct cache_coverage {
+    size_t runs;            // physically contiguous pieces of the buffer
+    size_t colors;          // colors with at least one line in the buffer
+    size_t total_colors;
+    size_t min_lines;       // fewest lines of the buffer in one set
+    size_t max_lines;       // most lines of the buffer in one set
+    size_t short_sets;      // sets with fewer lines than the cache has ways
+};
+
+/** Parse "malloc", "thp" or "hugetlb", returns 0 or -1 */
+int cache_buffer_kind(const char *name, enum buffer_kind *kind);
+
+/** Name of 'kind' */
+const char *cache_buffer_kind_name(enum buffer_kind kind);
+
+/**
+ * Allocate 'size' bytes of 'kind' and fault them in, returns 0 or -1 with the
+ * reason printed
+ */
+int cache_buffer_alloc(struct cache_buffer *buf, size_t size, enum buffer_kind kind);
+
+void cache_buffer_free(struct cache_buffer *buf);
+
+/** Find out which sets 'buf' covers, returns 0 or -1 if pagemap is unusable */
+int cache_buffer_coverage(const struct cache_buffer *buf, libflush_session_t *session,
+                          struct cache_coverage *cov);
+
+#endif // CACHE_BUFFER_H
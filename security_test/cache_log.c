@@ -0,0 +1,356 @@
+// Summarizes sample logs written by cache_test -l
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sample_log.h"
+
+// width of the longest histogram bar
+#define BAR_WIDTH 50
+
+struct Params {
+    bool csv;               // dump records instead of summarizing
+    double interval;        // seconds per summary row, 0 for whole log
+    size_t bins;            // histogram bins per group, 0 for none
+    char **files;
+    size_t count;
+} params;
+
+/** Mapped log */
+struct log_file {
+    const struct sample_log_hdr *hdr;
+    const struct sample_record *records;
+    uint64_t record_count;
+    size_t map_size;
+};
+
+/** Samples sharing op, core, tag and interval */
+struct group {
+    uint8_t op;
+    uint16_t core;
+    uint32_t tag;
+    uint64_t interval;
+    uint64_t *cycles;
+    size_t count;
+    size_t capacity;
+};
+
+static const char *op_names[] = SAMPLE_LOG_OP_NAMES;
+
+/** Parse params and save them to 'params' global struct */
+int parse_params(int argc, char **argv);
+/** Map log 'path', returns 0 or -1 with the reason printed */
+int open_log(struct log_file *log, const char *path);
+void close_log(struct log_file *log);
+/** Print all records of 'log' read from 'path' as CSV */
+void dump_csv(const struct log_file *log, const char *path);
+/** Print distribution of cycles per group */
+int summarize(const struct log_file *log);
+
+int main(int argc, char **argv) {
+    int ret = 0;
+
+    if (parse_params(argc, argv)) {
+        return -1;
+    }
+    if (params.csv) {
+        printf("file,time_ns,core,op,tag,cycles,median\n");
+    }
+    for (size_t i = 0; i < params.count; ++i) {
+        struct log_file log;
+
+        if (open_log(&log, params.files[i])) {
+            ret = -1;
+            continue;
+        }
+        if (params.csv) {
+            dump_csv(&log, params.files[i]);
+        }
+        else {
+            if (i) {
+                printf("\n");
+            }
+            printf("%s: ", params.files[i]);
+            if (summarize(&log)) {
+                ret = -1;
+            }
+        }
+        close_log(&log);
+    }
+    return ret;
+}
+
+int parse_params(int argc, char **argv) {
+    char usage_str[] = "%s [-c] [-i seconds] [-b bins] <log> [log]...\n"
+                       "  -c  print records as CSV instead of a summary\n"
+                       "  -i  one summary row per interval of this many seconds\n"
+                       "  -b  print a histogram with this many bins per row\n";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "ci:b:")) != -1) {
+        switch (opt) {
+            case 'c':
+                params.csv = true;
+                break;
+            case 'i':
+                params.interval = strtod(optarg, NULL);
+                break;
+            case 'b':
+                params.bins = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, usage_str, argv[0]);
+                return -1;
+        }
+    }
+    if (optind >= argc || params.interval < 0) {
+        fprintf(stderr, usage_str, argv[0]);
+        return -1;
+    }
+    params.files = argv + optind;
+    params.count = argc - optind;
+    return 0;
+}
+
+int open_log(struct log_file *log, const char *path) {
+    const struct sample_log_hdr *hdr;
+    struct stat st;
+    void *map;
+    int fd = open(path, O_RDONLY);
+    uint64_t fits;
+
+    if (fd < 0 || fstat(fd, &st)) {
+        perror(path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    if (st.st_size < (off_t)sizeof(*hdr)) {
+        fprintf(stderr, "%s: too short\n", path);
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+
+    hdr = map;
+    if (hdr->magic != SAMPLE_LOG_MAGIC || hdr->version != SAMPLE_LOG_VERSION ||
+        hdr->header_size < sizeof(*hdr) || hdr->header_size > st.st_size ||
+        hdr->record_size < sizeof(struct sample_record)) {
+        fprintf(stderr, "%s: not a cache_test log\n", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+    fits = (st.st_size - hdr->header_size) / hdr->record_size;
+    if (hdr->record_size != sizeof(struct sample_record)) {
+        fprintf(stderr, "%s: unsupported record size %u\n", path, hdr->record_size);
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    log->hdr = hdr;
+    log->records = (const struct sample_record *)((const uint8_t *)map + hdr->header_size);
+    // a log whose writer died has no count, the preallocated tail is zeroes
+    log->record_count = hdr->record_count && hdr->record_count <= fits ?
+                        hdr->record_count : fits;
+    while (hdr->record_count == 0 && log->record_count &&
+           log->records[log->record_count - 1].timestamp_ns == 0) {
+        log->record_count--;
+    }
+    log->map_size = st.st_size;
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+void close_log(struct log_file *log) {
+    munmap((void *)log->hdr, log->map_size);
+}
+
+static const char *op_name(uint8_t op) {
+    return op < sizeof(op_names) / sizeof(*op_names) ? op_names[op] : "?";
+}
+
+void dump_csv(const struct log_file *log, const char *path) {
+    for (uint64_t i = 0; i < log->record_count; ++i) {
+        const struct sample_record *rec = &log->records[i];
+
+        printf("%s,%lu,%u,%s,%u,%lu,%lu\n", path,
+               rec->timestamp_ns - log->hdr->start_ns, rec->core, op_name(rec->op),
+               rec->tag, rec->cycles, rec->median);
+    }
+}
+
+static int cmp_uint64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int cmp_group(const void *a, const void *b) {
+    const struct group *x = a, *y = b;
+
+    if (x->op != y->op) {
+        return x->op - y->op;
+    }
+    if (x->core != y->core) {
+        return x->core - y->core;
+    }
+    if (x->tag != y->tag) {
+        return x->tag < y->tag ? -1 : 1;
+    }
+    return (x->interval > y->interval) - (x->interval < y->interval);
+}
+
+/** Nearest rank percentile of sorted 'values', same as rolling_stats_percentile() */
+static uint64_t percentile(const uint64_t *values, size_t count, double percent) {
+    size_t rank = (size_t)ceil(count * percent / 100);
+
+    return values[rank ? rank - 1 : 0];
+}
+
+static void print_histogram(const struct group *g) {
+    // leave the slowest 0.1% out, single outliers would squash everything else
+    uint64_t lo = g->cycles[0];
+    uint64_t hi = percentile(g->cycles, g->count, 99.9);
+    uint64_t width = (hi - lo) / params.bins + 1;
+    size_t *counts = calloc(params.bins, sizeof(*counts));
+    size_t max = 0, above = 0;
+
+    if (counts == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < g->count; ++i) {
+        if (g->cycles[i] > hi) {
+            above++;
+            continue;
+        }
+        size_t bin = (g->cycles[i] - lo) / width;
+
+        if (++counts[bin] > max) {
+            max = counts[bin];
+        }
+    }
+    for (size_t bin = 0; bin < params.bins; ++bin) {
+        int bar = max ? (int)((counts[bin] * BAR_WIDTH + max - 1) / max) : 0;
+
+        printf("  %10lu-%-10lu %10zu %.*s\n", lo + bin * width, lo + (bin + 1) * width - 1,
+               counts[bin], bar, "##################################################");
+    }
+    if (above) {
+        printf("  %10s>%-10lu %10zu\n", "", hi, above);
+    }
+    free(counts);
+}
+
+int summarize(const struct log_file *log) {
+    struct group *groups = NULL;
+    size_t ngroups = 0, capacity = 0;
+    uint64_t duration = 0;
+    uint64_t interval_ns = params.interval * 1e9;
+    time_t started = log->hdr->start_realtime_ns / 1000000000;
+    char date[32];
+    int ret = -1;
+
+    if (log->record_count) {
+        duration = log->records[log->record_count - 1].timestamp_ns - log->hdr->start_ns;
+    }
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&started));
+    printf("%lu samples in %.1f s, started %s, LLC %u bytes\n",
+           log->record_count, duration / 1e9, date, log->hdr->llc_size);
+
+    for (uint64_t i = 0; i < log->record_count; ++i) {
+        const struct sample_record *rec = &log->records[i];
+        uint64_t interval = interval_ns ?
+                            (rec->timestamp_ns - log->hdr->start_ns) / interval_ns : 0;
+        struct group *g = NULL;
+
+        // few groups, mostly hit the last one
+        for (size_t j = ngroups; j-- > 0;) {
+            if (groups[j].op == rec->op && groups[j].core == rec->core &&
+                groups[j].tag == rec->tag && groups[j].interval == interval) {
+                g = &groups[j];
+                break;
+            }
+        }
+        if (g == NULL) {
+            if (ngroups == capacity) {
+                struct group *grown;
+
+                capacity = capacity ? 2 * capacity : 16;
+                grown = realloc(groups, capacity * sizeof(*groups));
+                if (grown == NULL) {
+                    goto out;
+                }
+                groups = grown;
+            }
+            g = &groups[ngroups++];
+            memset(g, 0, sizeof(*g));
+            g->op = rec->op;
+            g->core = rec->core;
+            g->tag = rec->tag;
+            g->interval = interval;
+        }
+        if (g->count == g->capacity) {
+            uint64_t *grown;
+
+            g->capacity = g->capacity ? 2 * g->capacity : 1024;
+            grown = realloc(g->cycles, g->capacity * sizeof(*grown));
+            if (grown == NULL) {
+                goto out;
+            }
+            g->cycles = grown;
+        }
+        g->cycles[g->count++] = rec->cycles;
+    }
+    qsort(groups, ngroups, sizeof(*groups), cmp_group);
+
+    printf("%-6s %4s %10s %8s %10s %8s %8s %8s %8s %8s %8s %10s %10s\n", "op", "core", "tag",
+           "from s", "count", "min", "p50", "p90", "p99", "p99.9", "max", "mean", "stddev");
+    for (size_t j = 0; j < ngroups; ++j) {
+        struct group *g = &groups[j];
+        double mean = 0, var = 0;
+
+        qsort(g->cycles, g->count, sizeof(*g->cycles), cmp_uint64);
+        for (size_t i = 0; i < g->count; ++i) {
+            mean += g->cycles[i];
+        }
+        mean /= g->count;
+        for (size_t i = 0; i < g->count; ++i) {
+            var += (g->cycles[i] - mean) * (g->cycles[i] - mean);
+        }
+        var /= g->count;
+        printf("%-6s %4u %#10x %8.6g %10zu %8lu %8lu %8lu %8lu %8lu %8lu %10.1f %10.1f\n",
+               op_name(g->op), g->core, g->tag, g->interval * params.interval, g->count,
+               g->cycles[0], percentile(g->cycles, g->count, 50),
+               percentile(g->cycles, g->count, 90), percentile(g->cycles, g->count, 99),
+               percentile(g->cycles, g->count, 99.9), g->cycles[g->count - 1],
+               mean, sqrt(var));
+        if (params.bins) {
+            print_histogram(g);
+        }
+    }
+    ret = 0;
+
+out:
+    for (size_t j = 0; j < ngroups; ++j) {
+        free(groups[j].cycles);
+    }
+    free(groups);
+    if (ret) {
+        fprintf(stderr, "Out of memory\n");
+    }
+    return ret;
+}
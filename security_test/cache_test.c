@@ -1,7 +1,10 @@
+#define _GNU_SOURCE
 // set in Makefile
 #include DEVICE_CONFIGURATION
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 #include <signal.h>
 #include <stdio.h>
@@ -11,30 +14,68 @@
 #include <stdint.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <time.h>
 #include <libflush/libflush.h>
 #include <asm/unistd.h>
 
-// should be at least as long as the time it takes evict to finish one loop
+#include "cache_buffer.h"
+#include "prime_probe.h"
+#include "rolling_stats.h"
+#include "sample_log.h"
+
+// should be at least as long as the time it takes evict to finish one loop,
+// default for -u
 #define TIME_USLEEP 400*1000
-// how many samples to keep (and calculate median from). More samples results in
-// timing jumping less but it takes longer for it to register changes
+// how many samples to keep (and calculate median from), default for -w. More
+// samples results in timing jumping less but it takes longer for it to register
+// changes
 #define TIMING_SAMPLES 25
+// probe rounds summed into one heatmap line, default for -r
+#define PROBE_ROUNDS 100
+// pause between two probes, i.e. how long the victim has to evict our lines,
+// default for -p
+#define PROBE_USLEEP 1000
+// memory eviction sets are picked from, has to contain enough lines of every
+// set even when frames are handed out randomly
+#define PROBE_POOL_SIZE (8*(LLC_SIZE))
+// characters per heatmap line
+#define HEATMAP_WIDTH 64
 
 enum OP {
     EVICT,  // try to evict everything from cache
     TIME,   // time accesses
+    MATRIX, // time accesses on every core while other cores evict
+    PROBE,  // Prime+Probe every cache set
 };
+// logs store enum OP values, names are in SAMPLE_LOG_OP_NAMES
 
 struct Params {
     enum OP op;
     size_t *cache_lines;
     size_t count;
-} params;
+    size_t window;          // samples in the rolling median window
+    useconds_t sleep_us;    // pause between two timed samples
+    cpu_set_t cpus;         // cores used in matrix mode
+    size_t rounds;          // probes per heatmap line
+    useconds_t probe_us;    // pause between two probes
+    const char *heatmap;    // CSV file with per-set misses of every line
+    const char *log;        // binary log of every sample
+    bool quiet;             // don't print every sample
+    enum buffer_kind alloc; // how eviction buffers are allocated
+} params = {
+    .window = TIMING_SAMPLES,
+    .sleep_us = TIME_USLEEP,
+    .rounds = PROBE_ROUNDS,
+    .probe_us = PROBE_USLEEP,
+};
 
 // Moves cursor to beginning of the previous line
 const char CPL[] = "\033[F";
 static volatile atomic_bool stop = false;
 libflush_session_t* libflush_session;
+// NULL unless -l was given
+static struct sample_log *samples;
+static struct sample_log samples_file;
 // printed at the end to stop compiler from optimizing out code without any
 // visible use.
 uint8_t dummy_value;
@@ -51,17 +92,28 @@ void access_range(volatile uint8_t *addr, size_t size);
  * Access all cache lines in params.cache_lines and return how long it took.
  * Cache line <n> == addr[n*LINE_LENGTH]
  */
-uint64_t time_access(volatile uint8_t *addr);
+uint64_t time_access(libflush_session_t *session, volatile uint8_t *addr);
+/**
+ * Measure median access time on every core in params.cpus, first with no
+ * evictor running and then with evictors pinned to each other core, and
+ * print the resulting interference matrix
+ */
+int run_matrix(volatile uint8_t *addr);
+/**
+ * Prime+Probe all cache sets and print how many probes saw a miss, one line
+ * every params.rounds probes
+ */
+int run_probe();
+/** Parse cpu list like "0-1,3" into 'set' */
+int parse_cpus(const char *str, cpu_set_t *set);
+/** Print which cache sets 'buf' covers */
+void report_buffer(const char *what, const struct cache_buffer *buf);
+/** Log one sample taken on the current cpu if logging is enabled */
+void log_sample(enum OP op, uint32_t tag, uint64_t cycles, uint64_t median);
 /** Handle CTRL+C */
 void intHandler(int dummy);
-/** Push new element to the top of array, remove last */
-void push(void *arr, size_t count, size_t el_size, void *element);
-/** Compare 2 uin64_t values */
-int cmp_uint64(const void* a, const void* b);
 /** Return biggest value in array */
 uint64_t max_st(size_t *arr, size_t size);
-/** Push new_time to timings array and then return median value */
-uint64_t add_element_get_median(uint64_t *timings, uint64_t new_time);
 
 int main(int argc, char **argv) {
     signal(SIGINT, intHandler);
@@ -71,31 +123,74 @@ int main(int argc, char **argv) {
     if (prepare()) {
         return -1;
     }
+    if (params.op == MATRIX) {
+        size_t malloc_size = (max_st(params.cache_lines, params.count) + 1)*LINE_LENGTH;
+        volatile uint8_t *timed_mem = malloc(malloc_size);
+        int ret;
 
-    uint64_t timings[TIMING_SAMPLES] = { 0 };
+        if (timed_mem == NULL) {
+            perror("malloc");
+            cleanup();
+            return -1;
+        }
+        ret = run_matrix(timed_mem);
+
+        cleanup();
+        free((void*)timed_mem);
+        printf("Dummy value: %u\n", (unsigned int)dummy_value);
+        return ret;
+    }
+    if (params.op == PROBE) {
+        int ret = run_probe();
+
+        cleanup();
+        return ret;
+    }
+
+    struct rolling_stats timings;
     uint64_t median_baseline = 0;
     uint64_t median = 0;
     uint64_t time = 0;
+    int ret = 0;
 
     volatile uint8_t *vm_mem;
+    struct cache_buffer evict_buf;
     if (params.op == EVICT) {
         // allocate LLC_SIZE bytes. Reading all of it should put our data into
         // all/most of cache lines in cache
-        vm_mem = malloc(LLC_SIZE);
+        if (cache_buffer_alloc(&evict_buf, LLC_SIZE, params.alloc)) {
+            cleanup();
+            return -1;
+        }
+        report_buffer("Eviction buffer", &evict_buf);
+        vm_mem = evict_buf.addr;
     }
     else {
         // allocate enough memory to access highest index passed to program
         size_t max_line = max_st(params.cache_lines, params.count);
         size_t malloc_size = (max_line + 1)*LINE_LENGTH;
         vm_mem = malloc(malloc_size);
+        if (vm_mem == NULL) {
+            perror("malloc");
+            cleanup();
+            return -1;
+        }
     }
 
     // calculate baseline time it takes to access addresses
     if (params.op == TIME) {
+        if (rolling_stats_init(&timings, params.window)) {
+            fprintf(stderr, "Cannot allocate %zu samples\n", params.window);
+            ret = -1;
+            goto out;
+        }
         printf("Calculating median baseline. Don't evict.\n");
-        for (int i = 0; i < TIMING_SAMPLES; ++i) {
-            median_baseline = add_element_get_median(timings, time_access(vm_mem));
+        for (size_t i = 0; i < params.window; ++i) {
+            time = time_access(libflush_session, vm_mem);
+            rolling_stats_add(&timings, time);
+            log_sample(TIME, 0, time, rolling_stats_median(&timings));
         }
+        median_baseline = rolling_stats_median(&timings);
         printf("Calculated median time: %lu\n", median_baseline);
     }
 
@@ -105,26 +200,49 @@ int main(int argc, char **argv) {
                 time = libflush_get_timing(libflush_session);
                 access_range(vm_mem, LLC_SIZE);
                 time = libflush_get_timing(libflush_session) - time;
-                printf("\rEviction time: %0.3f ms   ", (float)time / 1000);
+                log_sample(EVICT, 0, time, 0);
+                if (!params.quiet) {
+                    printf("\rEviction time: %0.3f ms   ", (float)time / 1000);
+                }
                 break;
             case TIME:
-                time = time_access(vm_mem);
-                median = add_element_get_median(timings, time);
-                if (median > median_baseline)
-                    printf("\rMedian time diff from baseline:  %lu    ", median - median_baseline);
-                else
-                    printf("\rMedian time diff from baseline: -%lu    ", median_baseline - median);
-                fflush(NULL);
-                usleep(TIME_USLEEP);
+                time = time_access(libflush_session, vm_mem);
+                rolling_stats_add(&timings, time);
+                median = rolling_stats_median(&timings);
+                log_sample(TIME, 0, time, median);
+                if (!params.quiet) {
+                    if (median > median_baseline)
+                        printf("\rMedian time diff from baseline:  %lu", median - median_baseline);
+                    else
+                        printf("\rMedian time diff from baseline: -%lu", median_baseline - median);
+                    printf("  (p90 %lu, p99 %lu)    ", rolling_stats_percentile(&timings, 90),
+                           rolling_stats_percentile(&timings, 99));
+                    fflush(NULL);
+                }
+                if (params.sleep_us) {
+                    usleep(params.sleep_us);
+                }
+                break;
+            case MATRIX:
+            case PROBE:
                 break;
         }
     }
 
     printf("\nStopping\n");
+    if (params.op == TIME) {
+        rolling_stats_free(&timings);
+    }
+out:
     cleanup();
-    free((void*)vm_mem);
+    if (params.op == EVICT) {
+        cache_buffer_free(&evict_buf);
+    }
+    else {
+        free((void*)vm_mem);
+    }
     printf("Dummy value: %u\n", (unsigned int)dummy_value);
-    return 0;
+    return ret;
 }
 
 void intHandler(int dummy) {
@@ -135,24 +253,97 @@ void intHandler(int dummy) {
 }
 
 int parse_params(int argc, char **argv) {
-    char usage_str[] = "%s <evict|time> <cache_line> [cache_line]...\n";
-    if (argc < 2) {
-        fprintf(stderr, usage_str, argv[0]);
+    char usage_str[] = "%s [options] <evict|probe|time|matrix> <cache_line> [cache_line]...\n"
+                       "  -w  samples in the rolling median window (time, matrix, default %d)\n"
+                       "  -u  microseconds between two samples (time, matrix, default %d)\n"
+                       "  -c  cores used by matrix, e.g. 0-1,3 (default: all allowed)\n"
+                       "  -r  probes per heatmap line (probe, default %d)\n"
+                       "  -p  microseconds between two probes (probe, default %d)\n"
+                       "  -o  write per-set misses as CSV to file (probe)\n"
+                       "  -l  log every sample to binary file (evict, time, matrix)\n"
+                       "  -q  don't print every sample\n"
+                       "  -a  eviction buffers from malloc, thp or hugetlb (evict, matrix, probe)\n";
+    const char *prog = argv[0];
+    int opt;
+
+    if (sched_getaffinity(0, sizeof(params.cpus), &params.cpus)) {
+        perror("sched_getaffinity");
+        return -1;
+    }
+    cpu_set_t allowed = params.cpus, requested;
+
+    while ((opt = getopt(argc, argv, "w:u:c:r:p:o:l:qa:")) != -1) {
+        switch (opt) {
+            case 'c':
+                if (parse_cpus(optarg, &params.cpus)) {
+                    fprintf(stderr, "Invalid cpu list: %s\n", optarg);
+                    return -1;
+                }
+                CPU_AND(&requested, &allowed, &params.cpus);
+                if (!CPU_EQUAL(&requested, &params.cpus)) {
+                    fprintf(stderr, "Not all of cpus %s are online and allowed\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'w':
+                params.window = strtoul(optarg, NULL, 10);
+                break;
+            case 'u':
+                params.sleep_us = strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                params.rounds = strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                params.probe_us = strtoul(optarg, NULL, 10);
+                break;
+            case 'o':
+                params.heatmap = optarg;
+                break;
+            case 'l':
+                params.log = optarg;
+                break;
+            case 'q':
+                params.quiet = true;
+                break;
+            case 'a':
+                if (cache_buffer_kind(optarg, &params.alloc)) {
+                    fprintf(stderr, "Unknown allocation: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            default:
+                fprintf(stderr, usage_str, prog, TIMING_SAMPLES, TIME_USLEEP,
+                        PROBE_ROUNDS, PROBE_USLEEP);
+                return -1;
+        }
+    }
+    // positional arguments start at argv[1] again
+    argc -= optind - 1;
+    argv += optind - 1;
+    if (argc < 2 || params.window == 0 || params.rounds == 0) {
+        fprintf(stderr, usage_str, prog, TIMING_SAMPLES, TIME_USLEEP,
+                PROBE_ROUNDS, PROBE_USLEEP);
         return -1;
     }
 
     if (strcmp(argv[1], "evict") == 0) {
         params.op = EVICT;
     }
-    else if (strcmp(argv[1], "time") == 0) {
+    else if (strcmp(argv[1], "probe") == 0) {
+        params.op = PROBE;
+    }
+    else if (strcmp(argv[1], "time") == 0 || strcmp(argv[1], "matrix") == 0) {
         if (argc < 3) {
-            fprintf(stderr, usage_str, argv[0]);
+            fprintf(stderr, usage_str, prog, TIMING_SAMPLES, TIME_USLEEP,
+                    PROBE_ROUNDS, PROBE_USLEEP);
             return -1;
         }
-        params.op = TIME;
+        params.op = strcmp(argv[1], "time") == 0 ? TIME : MATRIX;
     }
     else {
-        fprintf(stderr, usage_str, argv[0]);
+        fprintf(stderr, usage_str, prog, TIMING_SAMPLES, TIME_USLEEP,
+                PROBE_ROUNDS, PROBE_USLEEP);
         return -1;
     }
     params.count = argc - 2;
@@ -169,12 +360,26 @@ int prepare() {
     if (libflush_init(&libflush_session, NULL) == false) {
         return -1;
     }
+    if (params.log) {
+        if (sample_log_open(&samples_file, params.log, LLC_SIZE)) {
+            perror(params.log);
+            libflush_terminate(libflush_session);
+            return -1;
+        }
+        samples = &samples_file;
+    }
 
     return 0;
 }
 
 void cleanup() {
     free(params.cache_lines);
+    if (samples) {
+        if (sample_log_close(samples)) {
+            perror(params.log);
+        }
+        samples = NULL;
+    }
     if (libflush_terminate(libflush_session) == false) {
         fprintf(stderr, "libflush_terminate failed\n");
     }
@@ -187,37 +392,268 @@ void access_range(volatile uint8_t *addr, size_t size) {
     }
 }
 
-uint64_t time_access(volatile uint8_t *addr) {
-    uint64_t time = libflush_get_timing(libflush_session);
+uint64_t time_access(libflush_session_t *session, volatile uint8_t *addr) {
+    uint64_t time = libflush_get_timing(session);
     for (int i=0; i<params.count; i++) {
         dummy_value ^= *(addr + params.cache_lines[i]*LINE_LENGTH);
     }
-    time = libflush_get_timing(libflush_session) - time;
+    time = libflush_get_timing(session) - time;
     return time;
 }
 
-void push(void *arr, size_t count, size_t el_size, void *element) {
-    void *end = arr + (count - 1)*el_size;
-    while (end > arr) {
-        memcpy(end, end-el_size, el_size);
-        end -= el_size;
+void report_buffer(const char *what, const struct cache_buffer *buf) {
+    struct cache_coverage cov;
+
+    if (cache_buffer_coverage(buf, libflush_session, &cov)) {
+        printf("%s: %zu bytes from %s, no physical addresses to check coverage\n",
+               what, buf->size, cache_buffer_kind_name(buf->kind));
+        return;
+    }
+    printf("%s: %zu bytes from %s in %zu physically contiguous pieces, "
+           "%zu/%zu colors, %zu-%zu lines per set, %zu sets not fully covered\n",
+           what, buf->size, cache_buffer_kind_name(buf->kind), cov.runs, cov.colors,
+           cov.total_colors, cov.min_lines, cov.max_lines, cov.short_sets);
+}
+
+void log_sample(enum OP op, uint32_t tag, uint64_t cycles, uint64_t median) {
+    if (samples) {
+        sample_log_add(samples, op, sched_getcpu(), tag, cycles, median);
+    }
+}
+
+int parse_cpus(const char *str, cpu_set_t *set) {
+    char *end;
+
+    CPU_ZERO(set);
+    do {
+        unsigned long first = strtoul(str, &end, 10);
+        unsigned long last = first;
+
+        if (end == str) {
+            return -1;
+        }
+        if (*end == '-') {
+            str = end + 1;
+            last = strtoul(str, &end, 10);
+            if (end == str) {
+                return -1;
+            }
+        }
+        if (first > last || last >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (unsigned long cpu = first; cpu <= last; ++cpu) {
+            CPU_SET(cpu, set);
+        }
+        str = end + 1;
+    } while (*end == ',');
+
+    return *end == '\0' && CPU_COUNT(set) ? 0 : -1;
+}
+
+/** Pin calling thread to 'cpu' */
+static int pin_to_cpu(int cpu) {
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    // pid 0 is the calling thread, not the whole process
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+
+struct evictor {
+    pthread_t thread;
+    int cpu;
+    struct cache_buffer buf;
+    volatile uint8_t *mem;  // LLC_SIZE bytes of 'buf', private to this evictor
+    bool failed;            // could not run on 'cpu', the cell is invalid
+};
+
+struct timer {
+    int cpu;
+    uint32_t evicting;      // mask of evicting cpus, for the log
+    volatile uint8_t *mem;
+    uint64_t median;
+};
+
+// cleared to stop all evictors of the current matrix cell
+static volatile atomic_bool evicting;
+
+static void *evictor_thread(void *arg) {
+    struct evictor *ev = arg;
+
+    if (pin_to_cpu(ev->cpu)) {
+        perror("sched_setaffinity");
+        ev->failed = true;
+        return NULL;
+    }
+    while (evicting && !stop) {
+        access_range(ev->mem, LLC_SIZE);
+    }
+    return NULL;
+}
+
+static void *timer_thread(void *arg) {
+    struct timer *tm = arg;
+    struct rolling_stats timings;
+    // perf based time sources only count the thread which opened them
+    libflush_session_t *session;
+
+    tm->median = 0;
+    if (pin_to_cpu(tm->cpu)) {
+        perror("sched_setaffinity");
+        return NULL;
+    }
+    if (libflush_init(&session, NULL) == false) {
+        return NULL;
+    }
+    if (rolling_stats_init(&timings, params.window) == 0) {
+        for (size_t i = 0; i < params.window && !stop; ++i) {
+            uint64_t time = time_access(session, tm->mem);
+
+            rolling_stats_add(&timings, time);
+            log_sample(MATRIX, tm->evicting, time, rolling_stats_median(&timings));
+            if (params.sleep_us) {
+                usleep(params.sleep_us);
+            }
+        }
+        tm->median = rolling_stats_median(&timings);
+        rolling_stats_free(&timings);
     }
-    memcpy(arr, element, el_size);
+    libflush_terminate(session);
+    return NULL;
 }
 
-int cmp_uint64(const void* a, const void* b)
-{
-    uint64_t arg1 = *(const uint64_t*)a;
-    uint64_t arg2 = *(const uint64_t*)b;
-    return (arg1 > arg2) - (arg1 < arg2);
+/**
+ * Time accesses on 'timer_cpu' while every cpu in 'evict_cpus' evicts, return
+ * median access time or 0 on failure
+ */
+static uint64_t measure_cell(struct evictor *evictors, int timer_cpu,
+                             const cpu_set_t *evict_cpus, volatile uint8_t *addr) {
+    struct timer tm = { .cpu = timer_cpu, .mem = addr };
+    pthread_t timer;
+    int cpu;
+    size_t started = 0;
+
+    evicting = true;
+    for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, evict_cpus)) {
+            continue;
+        }
+        if (cpu < 32) {
+            tm.evicting |= 1u << cpu;
+        }
+        evictors[started].cpu = cpu;
+        evictors[started].failed = false;
+        if (pthread_create(&evictors[started].thread, NULL, evictor_thread,
+                           &evictors[started])) {
+            break;
+        }
+        started++;
+    }
+    if (started == (size_t)CPU_COUNT(evict_cpus) &&
+        pthread_create(&timer, NULL, timer_thread, &tm) == 0) {
+        pthread_join(timer, NULL);
+    }
+    evicting = false;
+    while (started) {
+        pthread_join(evictors[--started].thread, NULL);
+        if (evictors[started].failed) {
+            tm.median = 0;
+        }
+    }
+
+    return tm.median;
 }
 
-uint64_t add_element_get_median(uint64_t *timings, uint64_t new_time) {
-    uint64_t timings_sorted[TIMING_SAMPLES];
-    push(timings, TIMING_SAMPLES, sizeof(new_time), &new_time);
-    memcpy(timings_sorted, timings, TIMING_SAMPLES*sizeof(new_time));
-    qsort(timings_sorted, TIMING_SAMPLES, sizeof(new_time), cmp_uint64);
-    return timings_sorted[TIMING_SAMPLES/2];
+/** Print one matrix cell, '-' if 'median' could not be measured */
+static void print_cell(uint64_t median, uint64_t baseline, size_t *failed) {
+    if (median == 0) {
+        printf(" %7s", "-");
+        (*failed)++;
+    } else {
+        printf(" %7ld", (long)(median - baseline));
+    }
+}
+
+int run_matrix(volatile uint8_t *addr) {
+    int ncpus = CPU_COUNT(&params.cpus);
+    size_t failed = 0;
+    struct evictor *evictors = calloc(ncpus, sizeof(*evictors));
+    cpu_set_t none, one, others;
+    int ret = -1;
+
+    if (evictors == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < ncpus; ++i) {
+        char what[32];
+
+        // faults the buffers in now so page faults don't hit the measurement
+        if (cache_buffer_alloc(&evictors[i].buf, LLC_SIZE, params.alloc)) {
+            goto out;
+        }
+        evictors[i].mem = evictors[i].buf.addr;
+        snprintf(what, sizeof(what), "Evictor %d buffer", i);
+        report_buffer(what, &evictors[i].buf);
+    }
+    CPU_ZERO(&none);
+
+    printf("Median time diff from baseline, rows: timing cpu, columns: evicting cpu\n");
+    printf("%6s %9s", "cpu", "baseline");
+    for (int e = 0; e < CPU_SETSIZE; ++e) {
+        if (CPU_ISSET(e, &params.cpus)) {
+            printf(" %7d", e);
+        }
+    }
+    printf(" %7s\n", "others");
+
+    for (int t = 0; t < CPU_SETSIZE && !stop; ++t) {
+        uint64_t baseline, median;
+
+        if (!CPU_ISSET(t, &params.cpus)) {
+            continue;
+        }
+        baseline = measure_cell(evictors, t, &none, addr);
+        if (baseline == 0) {
+            fprintf(stderr, "\nCannot time on cpu %d\n", t);
+            goto out;
+        }
+        printf("%6d %9lu", t, baseline);
+        fflush(NULL);
+
+        for (int e = 0; e < CPU_SETSIZE && !stop; ++e) {
+            if (!CPU_ISSET(e, &params.cpus)) {
+                continue;
+            }
+            // e == t shares the core, i.e. shows private cache interference
+            CPU_ZERO(&one);
+            CPU_SET(e, &one);
+            median = measure_cell(evictors, t, &one, addr);
+            print_cell(median, baseline, &failed);
+            fflush(NULL);
+        }
+        // all other cores evicting at once, worst case for a shared LLC
+        others = params.cpus;
+        CPU_CLR(t, &others);
+        median = CPU_COUNT(&others) ? measure_cell(evictors, t, &others, addr) : baseline;
+        print_cell(median, baseline, &failed);
+        printf("\n");
+    }
+    if (failed) {
+        printf("-: %zu cells not measured, a timer or evictor thread could not run\n",
+               failed);
+    }
+    ret = stop ? -1 : 0;
+
+out:
+    for (int i = 0; i < ncpus; ++i) {
+        if (evictors[i].mem) {
+            cache_buffer_free(&evictors[i].buf);
+        }
+    }
+    free(evictors);
+    return ret;
 }
 
 uint64_t max_st(size_t *arr, size_t size) {
@@ -229,3 +665,117 @@ uint64_t max_st(size_t *arr, size_t size) {
     }
     return max_val;
 }
+
+/** Shade for 'misses' out of 'probes', blank only if there were none */
+static char heat_char(uint64_t misses, uint64_t probes) {
+    static const char shades[] = " .:-=+*#%@";
+
+    if (misses == 0) {
+        return shades[0];
+    }
+    return shades[1 + misses * (sizeof(shades) - 3) / probes];
+}
+
+int run_probe() {
+    struct prime_probe pp;
+    uint32_t *misses = calloc(NUMBER_OF_SETS, sizeof(*misses));
+    // sets sharing the physical address bits above the page offset form one color
+    size_t sets_per_color = sysconf(_SC_PAGESIZE) / LINE_LENGTH;
+    size_t colors = NUMBER_OF_SETS / sets_per_color;
+    size_t chars_per_color;
+    size_t sets_per_char;
+    struct timespec start, now;
+    FILE *heatmap = NULL;
+    int ret = -1;
+
+    if (misses == NULL) {
+        return -1;
+    }
+    if (colors == 0) {
+        // cache smaller than a page, no colors
+        colors = 1;
+        sets_per_color = NUMBER_OF_SETS;
+    }
+    chars_per_color = colors < HEATMAP_WIDTH ? HEATMAP_WIDTH / colors : 1;
+    if (chars_per_color > sets_per_color) {
+        chars_per_color = sets_per_color;
+    }
+    sets_per_char = sets_per_color / chars_per_color;
+
+    printf("Building eviction sets\n");
+    if (prime_probe_init(&pp, libflush_session, PROBE_POOL_SIZE, params.alloc)) {
+        free(misses);
+        return -1;
+    }
+    if (params.heatmap) {
+        heatmap = fopen(params.heatmap, "w");
+        if (heatmap == NULL) {
+            perror(params.heatmap);
+            goto out;
+        }
+        fprintf(heatmap, "time_ms");
+        for (size_t set = 0; set < NUMBER_OF_SETS; ++set) {
+            fprintf(heatmap, ",set%zu", set);
+        }
+        fprintf(heatmap, "\n");
+    }
+    printf("Calibrating %d sets with %zu ways. Don't evict.\n", NUMBER_OF_SETS, pp.ways);
+    if (prime_probe_calibrate(&pp, params.rounds)) {
+        goto out;
+    }
+
+    printf("Probes with a miss, %zu sets per character, %zu probes per line, "
+           "columns grouped by color\n", sets_per_char, params.rounds);
+    printf("%8s", "time s");
+    for (size_t color = 0; color < colors; ++color) {
+        printf(" %-*zx", (int)chars_per_color, color);
+    }
+    printf("\n");
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    prime_probe_prime(&pp);
+    while (!stop) {
+        double elapsed;
+
+        memset(misses, 0, NUMBER_OF_SETS * sizeof(*misses));
+        for (size_t i = 0; i < params.rounds && !stop; ++i) {
+            if (params.probe_us) {
+                usleep(params.probe_us);
+            }
+            prime_probe_probe(&pp, misses);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+
+        printf("%8.1f", elapsed);
+        for (size_t set = 0; set < NUMBER_OF_SETS; set += sets_per_char) {
+            uint64_t sum = 0;
+
+            if (set % sets_per_color == 0) {
+                putchar(' ');
+            }
+            for (size_t i = set; i < set + sets_per_char; ++i) {
+                sum += misses[i];
+            }
+            putchar(heat_char(sum, (uint64_t)sets_per_char * params.rounds));
+        }
+        putchar('\n');
+        fflush(stdout);
+        if (heatmap) {
+            fprintf(heatmap, "%.0f", elapsed * 1000);
+            for (size_t set = 0; set < NUMBER_OF_SETS; ++set) {
+                fprintf(heatmap, ",%u", misses[set]);
+            }
+            fprintf(heatmap, "\n");
+        }
+    }
+    ret = 0;
+
+out:
+    if (heatmap && fclose(heatmap)) {
+        perror(params.heatmap);
+        ret = -1;
+    }
+    prime_probe_free(&pp);
+    free(misses);
+    return ret;
+}
@@ -0,0 +1,171 @@
+// set in Makefile
+#include DEVICE_CONFIGURATION
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "prime_probe.h"
+#include "rolling_stats.h"
+
+/** Time accessing all lines of 'set', alternating direction between calls */
+static uint64_t probe_set(struct prime_probe *pp, size_t set) {
+    volatile uint8_t **lines = &pp->lines[set * pp->ways];
+    uint64_t time = libflush_get_timing(pp->session);
+
+    // walking back over the lines just accessed keeps them from evicting
+    // each other under LRU-like replacement
+    if (pp->reverse) {
+        for (size_t i = pp->ways; i-- > 0;) {
+            (void)*lines[i];
+        }
+    } else {
+        for (size_t i = 0; i < pp->ways; ++i) {
+            (void)*lines[i];
+        }
+    }
+    return libflush_get_timing(pp->session) - time;
+}
+
+int prime_probe_init(struct prime_probe *pp, libflush_session_t *session, size_t pool_size,
+                     enum buffer_kind kind) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t *filled;
+    size_t missing = 0;
+
+    memset(pp, 0, sizeof(*pp));
+    pp->session = session;
+    pp->ways = (LLC_SIZE) / (NUMBER_OF_SETS * LINE_LENGTH);
+    if (pp->ways == 0) {
+        pp->ways = 1;
+    }
+    // every page is faulted in, i.e. has its own frame before asking for its address
+    if (cache_buffer_alloc(&pp->pool, pool_size, kind)) {
+        return -1;
+    }
+
+    pp->lines = calloc(NUMBER_OF_SETS * pp->ways, sizeof(*pp->lines));
+    pp->threshold = calloc(NUMBER_OF_SETS, sizeof(*pp->threshold));
+    filled = calloc(NUMBER_OF_SETS, sizeof(*filled));
+    if (pp->lines == NULL || pp->threshold == NULL || filled == NULL) {
+        fprintf(stderr, "Cannot allocate eviction sets\n");
+        free(filled);
+        prime_probe_free(pp);
+        return -1;
+    }
+
+    // malloc'ed pools need not start on a page, walk whole pages like
+    // cache_buffer_coverage() and skip the lines outside the pool
+    uintptr_t first = (uintptr_t)pp->pool.addr & ~(uintptr_t)(page - 1);
+    uintptr_t end = (uintptr_t)pp->pool.addr + pool_size;
+
+    for (uintptr_t va = first; va < end; va += page) {
+        uintptr_t pa = libflush_get_physical_address(session, va);
+
+        // pagemap reports PFN 0 to processes without CAP_SYS_ADMIN
+        if (pa / page == 0) {
+            fprintf(stderr, "No physical addresses, build libflush with "
+                            "HAVE_PAGEMAP_ACCESS=1 and run as root\n");
+            free(filled);
+            prime_probe_free(pp);
+            return -1;
+        }
+        for (uintptr_t line = va; line < va + page && line < end; line += LINE_LENGTH) {
+            size_t set = ((pa + line - va) / LINE_LENGTH) % NUMBER_OF_SETS;
+
+            if (line < (uintptr_t)pp->pool.addr) {
+                continue;
+            }
+            if (filled[set] < pp->ways) {
+                pp->lines[set * pp->ways + filled[set]++] = (volatile uint8_t *)line;
+            }
+        }
+    }
+    for (size_t set = 0; set < NUMBER_OF_SETS; ++set) {
+        missing += filled[set] < pp->ways;
+    }
+    free(filled);
+    if (missing) {
+        fprintf(stderr, "Only %zu of %d sets have %zu lines in %zu bytes, "
+                        "try a bigger pool\n",
+                NUMBER_OF_SETS - missing, NUMBER_OF_SETS, pp->ways, pool_size);
+        prime_probe_free(pp);
+        return -1;
+    }
+
+    return 0;
+}
+
+void prime_probe_free(struct prime_probe *pp) {
+    if (pp->pool.map) {
+        cache_buffer_free(&pp->pool);
+    }
+    free(pp->lines);
+    free(pp->threshold);
+    memset(pp, 0, sizeof(*pp));
+}
+
+int prime_probe_calibrate(struct prime_probe *pp, size_t rounds) {
+    struct rolling_stats hit, miss;
+    volatile uint8_t *line = pp->lines[0];
+    uint64_t penalty, margin;
+
+    if (rolling_stats_init(&hit, rounds)) {
+        return -1;
+    }
+    if (rolling_stats_init(&miss, rounds)) {
+        rolling_stats_free(&hit);
+        return -1;
+    }
+    // cost of one miss, from a single line that is cached or flushed
+    for (size_t i = 0; i < rounds; ++i) {
+        uint64_t time;
+
+        (void)*line;
+        time = libflush_get_timing(pp->session);
+        (void)*line;
+        rolling_stats_add(&hit, libflush_get_timing(pp->session) - time);
+
+        libflush_flush(pp->session, (void*)line);
+        time = libflush_get_timing(pp->session);
+        (void)*line;
+        rolling_stats_add(&miss, libflush_get_timing(pp->session) - time);
+    }
+    penalty = rolling_stats_median(&miss) - rolling_stats_median(&hit);
+    if (rolling_stats_median(&miss) <= rolling_stats_median(&hit)) {
+        fprintf(stderr, "Flushed line is not slower, miss detection will be noisy\n");
+        penalty = 0;
+    }
+    rolling_stats_free(&miss);
+    // half a miss above the usual time of a set that stayed cached
+    margin = penalty > 1 ? penalty / 2 : 1;
+
+    // the window only ever holds samples of the set being calibrated
+    for (size_t set = 0; set < NUMBER_OF_SETS; ++set) {
+        probe_set(pp, set);
+        for (size_t i = 0; i < rounds; ++i) {
+            pp->reverse = !pp->reverse;
+            rolling_stats_add(&hit, probe_set(pp, set));
+        }
+        pp->threshold[set] = rolling_stats_median(&hit) + margin;
+    }
+    rolling_stats_free(&hit);
+
+    return 0;
+}
+
+void prime_probe_prime(struct prime_probe *pp) {
+    for (size_t set = 0; set < NUMBER_OF_SETS; ++set) {
+        probe_set(pp, set);
+    }
+    pp->reverse = !pp->reverse;
+}
+
+void prime_probe_probe(struct prime_probe *pp, uint32_t *misses) {
+    for (size_t set = 0; set < NUMBER_OF_SETS; ++set) {
+        if (probe_set(pp, set) > pp->threshold[set]) {
+            misses[set]++;
+        }
+    }
+    pp->reverse = !pp->reverse;
+}
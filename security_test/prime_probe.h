@@ -0,0 +1,51 @@
+/*
+ * Prime+Probe on every set of the last level cache.
+ *
+ * Eviction sets are built from physical addresses read from /proc/self/pagemap
+ * (libflush has to be built with HAVE_PAGEMAP_ACCESS=1 and the program run as
+ * root): line 'pa' of a buffer maps to set (pa / LINE_LENGTH) % NUMBER_OF_SETS,
+ * so collecting 'ways' lines with the same set index gives an eviction set
+ * without any timing based search. The set index is taken from physical
+ * addresses as the VM sees them, i.e. it matches the real cache set only if
+ * the hypervisor does not recolor the VM's memory.
+ */
+#ifndef PRIME_PROBE_H
+#define PRIME_PROBE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libflush/libflush.h>
+
+#include "cache_buffer.h"
+
+struct prime_probe {
+    libflush_session_t *session;
+    struct cache_buffer pool;   // memory eviction sets are taken from
+    size_t ways;                // lines per eviction set
+    volatile uint8_t **lines;   // 'ways' lines of set s start at lines[s*ways]
+    uint64_t *threshold;        // per set, probe time above it is a miss
+    int reverse;                // direction of the next probe
+};
+
+/**
+ * Build eviction sets for all NUMBER_OF_SETS sets out of 'pool_size' bytes of
+ * fresh memory of 'kind', returns 0 or -1 with the reason printed
+ */
+int prime_probe_init(struct prime_probe *pp, libflush_session_t *session, size_t pool_size,
+                     enum buffer_kind kind);
+
+void prime_probe_free(struct prime_probe *pp);
+
+/** Derive per-set miss thresholds from 'rounds' probes of an idle cache */
+int prime_probe_calibrate(struct prime_probe *pp, size_t rounds);
+
+/** Fill every set with own lines */
+void prime_probe_prime(struct prime_probe *pp);
+
+/**
+ * Time every set, add 1 to misses[s] for every set s in which some of our
+ * lines were evicted since the last prime or probe. Probing primes again.
+ */
+void prime_probe_probe(struct prime_probe *pp, uint32_t *misses);
+
+#endif // PRIME_PROBE_H
@@ -0,0 +1,165 @@
+#include <stdlib.h>
+
+#include "rolling_stats.h"
+
+#define NIL -1
+
+static uint32_t node_size(const struct rolling_stats *rs, int32_t n) {
+    return n == NIL ? 0 : rs->nodes[n].size;
+}
+
+static void update(struct rolling_stats *rs, int32_t n) {
+    rs->nodes[n].size = 1 + node_size(rs, rs->nodes[n].left) +
+                        node_size(rs, rs->nodes[n].right);
+}
+
+/** Order by value, ties broken by age */
+static int less(const struct rolling_stats_node *a, const struct rolling_stats_node *b) {
+    return a->value < b->value || (a->value == b->value && a->seq < b->seq);
+}
+
+static uint32_t next_priority(struct rolling_stats *rs) {
+    // xorshift32, only has to be cheap and not sorted
+    rs->rng ^= rs->rng << 13;
+    rs->rng ^= rs->rng >> 17;
+    rs->rng ^= rs->rng << 5;
+    return rs->rng;
+}
+
+/** Merge treaps 'a' and 'b' where every key of 'a' is smaller */
+static int32_t merge(struct rolling_stats *rs, int32_t a, int32_t b) {
+    if (a == NIL) {
+        return b;
+    }
+    if (b == NIL) {
+        return a;
+    }
+    if (rs->nodes[a].priority > rs->nodes[b].priority) {
+        rs->nodes[a].right = merge(rs, rs->nodes[a].right, b);
+        update(rs, a);
+        return a;
+    }
+    rs->nodes[b].left = merge(rs, a, rs->nodes[b].left);
+    update(rs, b);
+    return b;
+}
+
+/** Split 't' into the nodes ordered before 'n' (*l) and the rest (*r) */
+static void split(struct rolling_stats *rs, int32_t t, int32_t n,
+                  int32_t *l, int32_t *r) {
+    if (t == NIL) {
+        *l = *r = NIL;
+        return;
+    }
+    if (less(&rs->nodes[t], &rs->nodes[n])) {
+        split(rs, rs->nodes[t].right, n, &rs->nodes[t].right, r);
+        *l = t;
+    } else {
+        split(rs, rs->nodes[t].left, n, l, &rs->nodes[t].left);
+        *r = t;
+    }
+    update(rs, t);
+}
+
+static int32_t insert(struct rolling_stats *rs, int32_t t, int32_t n) {
+    if (t == NIL) {
+        return n;
+    }
+    if (rs->nodes[n].priority > rs->nodes[t].priority) {
+        split(rs, t, n, &rs->nodes[n].left, &rs->nodes[n].right);
+        update(rs, n);
+        return n;
+    }
+    if (less(&rs->nodes[n], &rs->nodes[t])) {
+        rs->nodes[t].left = insert(rs, rs->nodes[t].left, n);
+    } else {
+        rs->nodes[t].right = insert(rs, rs->nodes[t].right, n);
+    }
+    update(rs, t);
+    return t;
+}
+
+static int32_t erase(struct rolling_stats *rs, int32_t t, int32_t n) {
+    if (t == n) {
+        return merge(rs, rs->nodes[n].left, rs->nodes[n].right);
+    }
+    if (less(&rs->nodes[n], &rs->nodes[t])) {
+        rs->nodes[t].left = erase(rs, rs->nodes[t].left, n);
+    } else {
+        rs->nodes[t].right = erase(rs, rs->nodes[t].right, n);
+    }
+    update(rs, t);
+    return t;
+}
+
+int rolling_stats_init(struct rolling_stats *rs, size_t window) {
+    if (window == 0 || window > INT32_MAX) {
+        return -1;
+    }
+    rs->nodes = calloc(window, sizeof(*rs->nodes));
+    if (rs->nodes == NULL) {
+        return -1;
+    }
+    rs->window = window;
+    rs->count = 0;
+    rs->oldest = 0;
+    rs->root = NIL;
+    rs->seq = 0;
+    rs->rng = 2463534242u;
+    return 0;
+}
+
+void rolling_stats_free(struct rolling_stats *rs) {
+    free(rs->nodes);
+    rs->nodes = NULL;
+}
+
+void rolling_stats_add(struct rolling_stats *rs, uint64_t value) {
+    struct rolling_stats_node *node;
+    int32_t n;
+
+    if (rs->count == rs->window) {
+        // reuse the node of the oldest sample for the new one
+        n = rs->oldest;
+        rs->root = erase(rs, rs->root, n);
+        rs->oldest = (rs->oldest + 1) % rs->window;
+    } else {
+        n = rs->count++;
+    }
+    node = &rs->nodes[n];
+    node->value = value;
+    node->seq = rs->seq++;
+    node->priority = next_priority(rs);
+    node->size = 1;
+    node->left = node->right = NIL;
+    rs->root = insert(rs, rs->root, n);
+}
+
+uint64_t rolling_stats_kth(const struct rolling_stats *rs, size_t k) {
+    int32_t t = rs->root;
+
+    while (t != NIL) {
+        uint32_t left = node_size(rs, rs->nodes[t].left);
+
+        if (k < left) {
+            t = rs->nodes[t].left;
+        } else if (k == left) {
+            return rs->nodes[t].value;
+        } else {
+            k -= left + 1;
+            t = rs->nodes[t].right;
+        }
+    }
+    return 0;
+}
+
+uint64_t rolling_stats_percentile(const struct rolling_stats *rs, unsigned percent) {
+    size_t rank;
+
+    if (rs->count == 0) {
+        return 0;
+    }
+    // nearest rank: smallest sample with at least 'percent'% of samples <= it
+    rank = (rs->count * (percent > 100 ? 100 : percent) + 99) / 100;
+    return rolling_stats_kth(rs, rank ? rank - 1 : 0);
+}
@@ -0,0 +1,54 @@
+/*
+ * Sliding-window order statistics.
+ *
+ * Keeps the last 'window' samples in a ring buffer and the same samples in an
+ * order-statistic treap (every node knows the size of its subtree), so adding
+ * a sample and evicting the oldest one costs O(log n) and any rank, e.g. the
+ * median or p99, is found in O(log n) as well. All memory is allocated once in
+ * rolling_stats_init(), nothing is allocated or copied per sample.
+ */
+#ifndef ROLLING_STATS_H
+#define ROLLING_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct rolling_stats_node {
+    uint64_t value;
+    uint64_t seq;           // insertion counter, makes equal values distinct
+    uint32_t priority;
+    uint32_t size;          // nodes in this subtree
+    int32_t left;
+    int32_t right;
+};
+
+struct rolling_stats {
+    struct rolling_stats_node *nodes;   // node i holds ring slot i
+    size_t window;
+    size_t count;
+    size_t oldest;          // ring slot evicted next once the window is full
+    int32_t root;
+    uint64_t seq;
+    uint32_t rng;
+};
+
+/** Allocate a window of 'window' samples, returns 0 or -1 */
+int rolling_stats_init(struct rolling_stats *rs, size_t window);
+
+void rolling_stats_free(struct rolling_stats *rs);
+
+/** Add 'value', dropping the oldest sample if the window is full */
+void rolling_stats_add(struct rolling_stats *rs, uint64_t value);
+
+/** Return the 'k'-th smallest sample (0-based), 'k' must be < count */
+uint64_t rolling_stats_kth(const struct rolling_stats *rs, size_t k);
+
+/** Return the 'percent' percentile (nearest rank), 0 if the window is empty */
+uint64_t rolling_stats_percentile(const struct rolling_stats *rs, unsigned percent);
+
+/** Return the median, i.e. sample count / 2 of the sorted window */
+static inline uint64_t rolling_stats_median(const struct rolling_stats *rs) {
+    return rs->count ? rolling_stats_kth(rs, rs->count / 2) : 0;
+}
+
+#endif // ROLLING_STATS_H
@@ -0,0 +1,163 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sample_log.h"
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t sample_log_now_ns() {
+    return clock_ns(CLOCK_MONOTONIC);
+}
+
+/** write() all of 'buf' at 'offset', returns 0 or errno */
+static int write_all(int fd, const void *buf, size_t size, off_t offset) {
+    while (size) {
+        ssize_t ret = pwrite(fd, buf, size, offset);
+
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        buf = (const uint8_t *)buf + ret;
+        size -= ret;
+        offset += ret;
+    }
+    return 0;
+}
+
+static void *writer_thread(void *arg) {
+    struct sample_log *log = arg;
+
+    pthread_mutex_lock(&log->lock);
+    for (;;) {
+        while (log->pending == 0 && !log->closing) {
+            pthread_cond_wait(&log->cond, &log->lock);
+        }
+        if (log->pending == 0) {
+            break;
+        }
+        // the measuring thread only touches the active buffer
+        struct sample_record *buf = log->buf[!log->active];
+        size_t size = log->pending * sizeof(*buf);
+        pthread_mutex_unlock(&log->lock);
+
+        if (log->error == 0 && log->written + (off_t)size > log->allocated) {
+            // failing to preallocate is fine, the write below extends the file
+            if (posix_fallocate(log->fd, log->allocated, SAMPLE_LOG_PREALLOC) == 0) {
+                log->allocated += SAMPLE_LOG_PREALLOC;
+            }
+        }
+        if (log->error == 0) {
+            log->error = write_all(log->fd, buf, size, log->written);
+            if (log->error == 0) {
+                log->written += size;
+            }
+        }
+
+        pthread_mutex_lock(&log->lock);
+        log->pending = 0;
+        pthread_cond_signal(&log->cond);
+    }
+    pthread_mutex_unlock(&log->lock);
+    return NULL;
+}
+
+int sample_log_open(struct sample_log *log, const char *path, uint32_t llc_size) {
+    memset(log, 0, sizeof(*log));
+    log->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (log->fd < 0) {
+        return -1;
+    }
+    for (int i = 0; i < 2; ++i) {
+        log->buf[i] = malloc(SAMPLE_LOG_RECORDS * sizeof(struct sample_record));
+        if (log->buf[i] == NULL) {
+            goto err;
+        }
+        // fault the buffers in now rather than while sampling
+        memset(log->buf[i], 0, SAMPLE_LOG_RECORDS * sizeof(struct sample_record));
+    }
+
+    log->hdr.magic = SAMPLE_LOG_MAGIC;
+    log->hdr.version = SAMPLE_LOG_VERSION;
+    log->hdr.header_size = sizeof(log->hdr);
+    log->hdr.record_size = sizeof(struct sample_record);
+    log->hdr.llc_size = llc_size;
+    log->hdr.start_ns = sample_log_now_ns();
+    log->hdr.start_realtime_ns = clock_ns(CLOCK_REALTIME);
+    // record_count stays 0 until sample_log_close()
+    errno = write_all(log->fd, &log->hdr, sizeof(log->hdr), 0);
+    if (errno) {
+        goto err;
+    }
+    log->written = sizeof(log->hdr);
+
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->cond, NULL);
+    errno = pthread_create(&log->thread, NULL, writer_thread, log);
+    if (errno) {
+        pthread_cond_destroy(&log->cond);
+        pthread_mutex_destroy(&log->lock);
+        goto err;
+    }
+    return 0;
+
+err:
+    free(log->buf[0]);
+    free(log->buf[1]);
+    close(log->fd);
+    return -1;
+}
+
+void sample_log_swap(struct sample_log *log) {
+    pthread_mutex_lock(&log->lock);
+    // only happens if the disk is slower than sampling
+    while (log->pending) {
+        pthread_cond_wait(&log->cond, &log->lock);
+    }
+    log->pending = log->used;
+    log->active = !log->active;
+    log->used = 0;
+    pthread_cond_signal(&log->cond);
+    pthread_mutex_unlock(&log->lock);
+}
+
+int sample_log_close(struct sample_log *log) {
+    int ret = 0;
+
+    if (log->used) {
+        sample_log_swap(log);
+    }
+    pthread_mutex_lock(&log->lock);
+    log->closing = true;
+    pthread_cond_signal(&log->cond);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->thread, NULL);
+    pthread_cond_destroy(&log->cond);
+    pthread_mutex_destroy(&log->lock);
+
+    log->hdr.record_count = (log->written - sizeof(log->hdr)) / sizeof(struct sample_record);
+    if (log->error || ftruncate(log->fd, log->written) ||
+        write_all(log->fd, &log->hdr, sizeof(log->hdr), 0)) {
+        if (log->error) {
+            errno = log->error;
+        }
+        ret = -1;
+    }
+    if (close(log->fd)) {
+        ret = -1;
+    }
+    free(log->buf[0]);
+    free(log->buf[1]);
+    return ret;
+}
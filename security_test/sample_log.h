@@ -0,0 +1,106 @@
+/*
+ * Binary log of every sample taken by cache_test.
+ *
+ * A log is a 64 byte header followed by fixed-size records. Records are
+ * collected in one of two preallocated buffers; once a buffer is full a
+ * background thread writes it out while the other one fills up, so the
+ * measuring thread never waits for the disk unless the disk cannot keep up
+ * at all. The file is extended in large preallocated chunks and trimmed when
+ * the log is closed. Everything is stored in the byte order of the machine
+ * that took the samples.
+ *
+ * The writer fills in 'record_count' when the log is closed. A log whose
+ * writer died leaves it at 0 and readers take the count from the file size.
+ */
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define SAMPLE_LOG_MAGIC        0x474c5443 // "CTLG"
+#define SAMPLE_LOG_VERSION      1
+// records per buffer, 2 MiB
+#define SAMPLE_LOG_RECORDS      (64*1024)
+// the file grows by this much at once
+#define SAMPLE_LOG_PREALLOC     (64*1024*1024)
+
+// names of the 'op' values, same order as enum OP in cache_test.c
+#define SAMPLE_LOG_OP_NAMES     { "evict", "time", "matrix", "probe" }
+
+struct sample_log_hdr {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;       // first record, relative to the file start
+    uint16_t record_size;
+    uint16_t reserved0;
+    uint32_t llc_size;
+    uint64_t record_count;
+    uint64_t start_ns;          // CLOCK_MONOTONIC when the log was created
+    uint64_t start_realtime_ns; // CLOCK_REALTIME at the same moment
+    uint8_t reserved[24];
+};
+
+_Static_assert(sizeof(struct sample_log_hdr) == 64, "sample log header layout changed");
+
+struct sample_record {
+    uint64_t timestamp_ns;      // CLOCK_MONOTONIC
+    uint64_t cycles;            // raw libflush_get_timing() difference
+    uint64_t median;            // rolling median including this sample, 0 if none
+    uint32_t tag;               // matrix: mask of evicting cpus, 0 otherwise
+    uint16_t core;              // cpu the sample was taken on
+    uint8_t op;
+    uint8_t reserved;
+};
+
+_Static_assert(sizeof(struct sample_record) == 32, "sample record layout changed");
+
+struct sample_log {
+    int fd;
+    struct sample_log_hdr hdr;
+    struct sample_record *buf[2];
+    int active;                 // buffer being filled
+    size_t used;                // records in the active buffer
+    size_t pending;             // records in the other buffer not written yet
+    bool closing;
+    int error;                  // errno of the first failed write
+    off_t written;
+    off_t allocated;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+/** Create log 'path' and start its writer thread, returns 0 or -1 with errno */
+int sample_log_open(struct sample_log *log, const char *path, uint32_t llc_size);
+
+/** Write everything logged so far and close the log, returns 0 or -1 */
+int sample_log_close(struct sample_log *log);
+
+/** Hand a full buffer to the writer thread, only called by sample_log_add() */
+void sample_log_swap(struct sample_log *log);
+
+/** Current CLOCK_MONOTONIC time in nanoseconds */
+uint64_t sample_log_now_ns();
+
+/** Append one sample, does not block unless both buffers are full */
+static inline void sample_log_add(struct sample_log *log, uint8_t op, uint16_t core,
+                                  uint32_t tag, uint64_t cycles, uint64_t median) {
+    struct sample_record *rec = &log->buf[log->active][log->used];
+
+    rec->timestamp_ns = sample_log_now_ns();
+    rec->cycles = cycles;
+    rec->median = median;
+    rec->tag = tag;
+    rec->core = core;
+    rec->op = op;
+    rec->reserved = 0;
+    if (++log->used == SAMPLE_LOG_RECORDS) {
+        sample_log_swap(log);
+    }
+}
+
+#endif // SAMPLE_LOG_H